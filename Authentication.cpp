@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <random>
 #include <chrono>
+#include <utility>
 
 // Password Hasher implementation
 std::string PasswordHasher::generateSalt(size_t length) {
@@ -66,9 +67,11 @@ bool PasswordHasher::verifyPassword(const std::string& password, const std::stri
 }
 
 // Authentication Manager implementation
-AuthenticationManager::AuthenticationManager() : currentUserId(0) {}
+template <typename Backend>
+BasicAuthenticationManager<Backend>::BasicAuthenticationManager() : currentUserId(0) {}
 
-std::string AuthenticationManager::generateSessionToken() {
+template <typename Backend>
+std::string BasicAuthenticationManager<Backend>::generateSessionToken() {
     auto now = std::chrono::system_clock::now();
     auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
     auto value = now_ms.time_since_epoch().count();
@@ -82,25 +85,23 @@ std::string AuthenticationManager::generateSessionToken() {
     return ss.str();
 }
 
-bool AuthenticationManager::registerUser(const std::string& username, const std::string& password) {
-    // Check if username already exists
-    User existingUser = storage.getUserByUsername(username);
-    if (existingUser.getId() != 0) {
+template <typename Backend>
+bool BasicAuthenticationManager<Backend>::registerUser(const std::string& username, const std::string& password) {
+    // Skip hashing for names that are plainly taken; createUser makes the
+    // filtered check, so this one goes to the index alone
+    if (storage.getUserByUsername(username).getId() != 0) {
         return false; // User already exists
     }
     
     // Hash password
     std::string hashedPassword = PasswordHasher::hashPassword(password);
     
-    // Create new user
-    int userId = storage.getNextUserId();
-    User newUser(userId, username, hashedPassword);
-    
-    // Save user
-    return storage.saveUser(newUser);
+    // Claim the name and an id, and save along with concurrent registrations
+    return storage.createUser(username, std::move(hashedPassword)) != 0;
 }
 
-bool AuthenticationManager::login(const std::string& username, const std::string& password) {
+template <typename Backend>
+bool BasicAuthenticationManager<Backend>::login(const std::string& username, const std::string& password) {
     User user = storage.getUserByUsername(username);
     if (user.getId() == 0) {
         return false; // User not found
@@ -127,30 +128,35 @@ bool AuthenticationManager::login(const std::string& username, const std::string
     return true;
 }
 
-bool AuthenticationManager::logout() {
+template <typename Backend>
+bool BasicAuthenticationManager<Backend>::logout() {
     if (!isLoggedIn()) {
         return false;
     }
     
     bool result = storage.deleteSession(currentSessionToken);
-    currentSessionToken = "";
+    currentSessionToken.clear();
     currentUserId = 0;
     return result;
 }
 
-bool AuthenticationManager::isLoggedIn() const {
+template <typename Backend>
+bool BasicAuthenticationManager<Backend>::isLoggedIn() const {
     return !currentSessionToken.empty() && currentUserId > 0;
 }
 
-std::string AuthenticationManager::getCurrentSessionToken() const {
+template <typename Backend>
+const std::string& BasicAuthenticationManager<Backend>::getCurrentSessionToken() const {
     return currentSessionToken;
 }
 
-int AuthenticationManager::getCurrentUserId() const {
+template <typename Backend>
+int BasicAuthenticationManager<Backend>::getCurrentUserId() const {
     return currentUserId;
 }
 
-bool AuthenticationManager::validateSession(const std::string& token) {
+template <typename Backend>
+bool BasicAuthenticationManager<Backend>::validateSession(const std::string& token) {
     Session session = storage.getSessionByToken(token);
     if (session.getUserId() == 0 || !session.isValid()) {
         return false;
@@ -161,4 +167,24 @@ bool AuthenticationManager::validateSession(const std::string& token) {
     storage.saveSession(session);
     
     return true;
-}
\ No newline at end of file
+}
+
+template <typename Backend>
+void BasicAuthenticationManager<Backend>::setDurability(Durability mode) {
+    storage.setDurability(mode);
+}
+
+template <typename Backend>
+void BasicAuthenticationManager<Backend>::preload() {
+    storage.preload();
+}
+
+template <typename Backend>
+void BasicAuthenticationManager<Backend>::shutdown() {
+    storage.saveUsernameFilter();
+}
+
+// Backends available to BasicAuthenticationManager
+template class BasicAuthenticationManager<CsvBackend>;
+template class BasicAuthenticationManager<MemoryBackend>;
+template class BasicAuthenticationManager<LogBackend>;
\ No newline at end of file
@@ -15,10 +15,11 @@ public:
     static bool verifyPassword(const std::string& password, const std::string& storedHash);
 };
 
-// Authentication manager class
-class AuthenticationManager {
+// Authentication manager class, parameterized on the storage backend
+template <typename Backend>
+class BasicAuthenticationManager {
 private:
-    Storage storage;
+    BasicStorage<Backend> storage;
     std::string currentSessionToken;
     int currentUserId;
     
@@ -26,7 +27,7 @@ private:
     std::string generateSessionToken();
 
 public:
-    AuthenticationManager();
+    BasicAuthenticationManager();
     
     // User management
     bool registerUser(const std::string& username, const std::string& password);
@@ -35,9 +36,21 @@ public:
     bool isLoggedIn() const;
     
     // Session management
-    std::string getCurrentSessionToken() const;
+    const std::string& getCurrentSessionToken() const;
     int getCurrentUserId() const;
     bool validateSession(const std::string& token);
+    
+    // Whether persisting calls wait for their writes to be fsynced
+    void setDurability(Durability mode);
+    
+    // Index users and sessions ahead of the first request
+    void preload();
+    
+    // Persist state kept in memory while running, before exiting
+    void shutdown();
 };
 
+// Default authentication manager over CSV files
+using AuthenticationManager = BasicAuthenticationManager<CsvBackend>;
+
 #endif
\ No newline at end of file
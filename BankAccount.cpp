@@ -1,33 +1,39 @@
 #include "BankAccount.h"
 #include "Storage.h"
 #include <sstream>
-#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <memory>
+#include <utility>
 #include <vector>
 
-// Utility function to split strings (if not already defined in Storage.h)
-std::vector<std::string> splitString(const std::string& s, char delimiter) {
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter)) {
-        tokens.push_back(token);
+namespace {
+
+// FNV-1a over a whole file, to tie the saved portfolios to the accounts
+uint64_t contentsChecksum(std::string_view contents) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : contents) {
+        hash = (hash ^ c) * 1099511628211ULL;
     }
-    return tokens;
+    return hash;
 }
 
+} // namespace
+
 // BankAccount methods implementation
-BankAccount::BankAccount(int userId, const std::string& accountId, const std::string& name, double initialBalance)
-    : userId(userId), accountId(accountId), name(name), balance(initialBalance) {}
+BankAccount::BankAccount(int userId, std::string accountId, std::string name, double initialBalance)
+    : userId(userId), accountId(std::move(accountId)), name(std::move(name)), balance(initialBalance) {}
 
 int BankAccount::getUserId() const {
     return userId;
 }
 
-std::string BankAccount::getAccountId() const {
+const std::string& BankAccount::getAccountId() const {
     return accountId;
 }
 
-std::string BankAccount::getName() const {
+const std::string& BankAccount::getName() const {
     return name;
 }
 
@@ -62,64 +68,473 @@ std::string BankAccount::serialize() const {
     return ss.str();
 }
 
-BankAccount BankAccount::deserialize(const std::string& data) {
-    auto parts = splitString(data, ',');
-    if (parts.size() >= 4) {
-        int userId = std::stoi(parts[0]);
-        std::string accountId = parts[1];
-        std::string name = parts[2];
-        double balance = std::stod(parts[3]);
-        return BankAccount(userId, accountId, name, balance);
+BankAccount BankAccount::deserialize(std::string_view data) {
+    int userId = parseNumber<int>(nextField(data, ','));
+    std::string_view accountId = nextField(data, ',');
+    std::string_view name = nextField(data, ',');
+    if (!data.empty()) {
+        double balance = parseNumber<double>(nextField(data, ','));
+        return BankAccount(userId, std::string(accountId), std::string(name), balance);
     }
     // Return a default account if data is invalid
     return BankAccount(0, "", "", 0.0);
 }
 
+// PortfolioSummary implementation
+std::string PortfolioSummary::serialize() const {
+    // Shortest round-trip form, so reloaded totals match exactly; this runs
+    // for every user on every save
+    char number[32];
+    std::string line;
+    line.append(number, std::to_chars(number, number + sizeof(number), userId).ptr);
+    line += ',';
+    line.append(number, std::to_chars(number, number + sizeof(number), totalBalance).ptr);
+    line += ',';
+    line.append(number, std::to_chars(number, number + sizeof(number), accountCount).ptr);
+    line += ',';
+    line.append(number, std::to_chars(number, number + sizeof(number), static_cast<long long>(lastActivity)).ptr);
+    return line;
+}
+
+PortfolioSummary PortfolioSummary::deserialize(std::string_view data) {
+    PortfolioSummary summary;
+    summary.userId = parseNumber<int>(nextField(data, ','));
+    summary.totalBalance = parseNumber<double>(nextField(data, ','));
+    summary.accountCount = parseNumber<size_t>(nextField(data, ','));
+    summary.lastActivity = parseNumber<time_t>(nextField(data, ','));
+    return summary;
+}
+
+// AccountIndex implementation
+AccountIndex::AccountIndex(std::string data) : contents(std::move(data)) {
+    size_t count = 0;
+    forEachLine(contents, [&count](std::string_view) { count++; });
+    
+    // Only the ids are parsed up front
+    entries = std::vector<Entry>(count);
+    size_t i = 0;
+    forEachLine(contents, [this, &i](std::string_view line) {
+        Entry& entry = entries[i++];
+        entry.line = line;
+        entry.userId = parseNumber<int>(nextField(line, ','));
+        entry.accountId = nextField(line, ',');
+    });
+}
+
+AccountIndex::~AccountIndex() {
+    for (const Entry& entry : entries) {
+        delete entry.record.load();
+    }
+}
+
+const BankAccount& AccountIndex::hydrate(size_t i) const {
+    const Entry& entry = entries[i];
+    const BankAccount* record = entry.record.load(std::memory_order_acquire);
+    if (record == nullptr) {
+        // Losing the race just discards our copy
+        const BankAccount* parsed = new BankAccount(BankAccount::deserialize(entry.line));
+        if (entry.record.compare_exchange_strong(record, parsed, std::memory_order_acq_rel)) {
+            record = parsed;
+        } else {
+            delete parsed;
+        }
+    }
+    return *record;
+}
+
 // Bank methods implementation
-void Bank::addAccount(const BankAccount& account) {
-    accounts.push_back(account);
-    saveAccounts();
+template <typename Backend>
+BasicBank<Backend>::BasicBank() : table(new AccountTable()) {}
+
+template <typename Backend>
+BasicBank<Backend>::~BasicBank() {
+    stopWarmer();
+    const AccountTable* current = table.load();
+    for (const BankAccount* account : current->records) {
+        delete account;
+    }
+    delete current;
 }
 
-BankAccount* Bank::findAccount(const std::string& accountId) {
-    for (auto& account : accounts) {
-        if (account.getAccountId() == accountId) {
-            return &account;
+template <typename Backend>
+const BankAccount* BasicBank<Backend>::findIn(const AccountTable& accounts, std::string_view accountId) {
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        if (accounts.idAt(i) == accountId) {
+            return &accounts.at(i);
         }
     }
     return nullptr;
 }
 
-std::vector<BankAccount> Bank::findAccountsByUserId(int userId) {
-    std::vector<BankAccount> userAccounts;
-    for (const auto& account : accounts) {
-        if (account.getUserId() == userId) {
-            userAccounts.push_back(account);
+template <typename Backend>
+void BasicBank<Backend>::publish(AccountTable* next, std::vector<const BankAccount*> replaced) {
+    const AccountTable* previous = table.exchange(next);
+    epochs.retire(previous);
+    for (const BankAccount* account : replaced) {
+        // Records still owned by the index are freed with it
+        if (account != nullptr) {
+            epochs.retire(account);
+        }
+    }
+}
+
+template <typename Backend>
+template <typename Update>
+bool BasicBank<Backend>::modifyAccount(std::string_view accountId, Update&& update) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const AccountTable& current = *table.load();
+    for (size_t i = 0; i < current.size(); ++i) {
+        if (current.idAt(i) == accountId) {
+            std::unique_ptr<BankAccount> updated(new BankAccount(current.at(i)));
+            if (!update(*updated)) {
+                return false;
+            }
+            adjustPortfolio(updated->getUserId(), updated->getBalance() - current.at(i).getBalance(), 0);
+            AccountTable* next = new AccountTable(current);
+            next->records[i] = updated.release();
+            publish(next, {current.records[i]});
+            return saveTable(*next);
         }
     }
+    return false;
+}
+
+template <typename Backend>
+typename BasicBank<Backend>::Snapshot BasicBank<Backend>::snapshot() const {
+    return Snapshot(epochs, table);
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::addAccount(BankAccount account) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const AccountTable& current = *table.load();
+    
+    // Only ids the filter may have seen need the exact scan
+    if (accountFilter.mightContain(account.getAccountId())) {
+        if (findIn(current, account.getAccountId()) != nullptr) {
+            return false;
+        }
+        accountFilter.recordFalsePositive();
+    }
+    
+    AccountTable* next = new AccountTable(current);
+    next->records.push_back(new BankAccount(std::move(account)));
+    const BankAccount& added = *next->records.back();
+    adjustPortfolio(added.getUserId(), added.getBalance(), 1);
+    accountFilter.add(added.getAccountId());
+    if (accountFilter.isOverloaded()) {
+        rebuildAccountFilter(*next);
+    }
+    publish(next, {});
+    return saveTable(*next);
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::deposit(std::string_view accountId, double amount) {
+    return modifyAccount(accountId, [amount](BankAccount& account) { return account.deposit(amount); });
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::withdraw(std::string_view accountId, double amount) {
+    return modifyAccount(accountId, [amount](BankAccount& account) { return account.withdraw(amount); });
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::transfer(std::string_view fromAccountId, std::string_view toAccountId, double amount) {
+    if (fromAccountId == toAccountId) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const AccountTable& current = *table.load();
+    size_t from = current.size();
+    size_t to = current.size();
+    for (size_t i = 0; i < current.size(); ++i) {
+        if (current.idAt(i) == fromAccountId) {
+            from = i;
+        } else if (current.idAt(i) == toAccountId) {
+            to = i;
+        }
+    }
+    if (from == current.size() || to == current.size()) {
+        return false;
+    }
+    
+    // Both sides become visible in the same version
+    std::unique_ptr<BankAccount> source(new BankAccount(current.at(from)));
+    std::unique_ptr<BankAccount> target(new BankAccount(current.at(to)));
+    if (!source->withdraw(amount) || !target->deposit(amount)) {
+        return false;
+    }
+    adjustPortfolio(source->getUserId(), -amount, 0);
+    adjustPortfolio(target->getUserId(), amount, 0);
+    AccountTable* next = new AccountTable(current);
+    next->records[from] = source.release();
+    next->records[to] = target.release();
+    publish(next, {current.records[from], current.records[to]});
+    return saveTable(*next);
+}
+
+template <typename Backend>
+double BasicBank<Backend>::getBalance(std::string_view accountId) const {
+    Snapshot view = snapshot();
+    const BankAccount* account = view.find(accountId);
+    return account != nullptr ? account->getBalance() : -1;
+}
+
+template <typename Backend>
+std::vector<BankAccount> BasicBank<Backend>::findAccountsByUserId(int userId) const {
+    std::vector<BankAccount> userAccounts;
+    forEachAccountOfUser(userId, [&userAccounts](const BankAccount& account) {
+        userAccounts.push_back(account);
+    });
     return userAccounts;
 }
 
-void Bank::loadAccounts() {
-    accounts.clear();
-    std::ifstream file("accounts.csv");
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            if (!line.empty()) {
-                accounts.push_back(BankAccount::deserialize(line));
+template <typename Backend>
+void BasicBank<Backend>::loadAccounts() {
+    stopWarmer();
+    AccountTable* next = new AccountTable();
+    std::string contents = backend.read(ACCOUNTS_FILE);
+    forEachLine(contents, [next](std::string_view line) {
+        next->records.push_back(new BankAccount(BankAccount::deserialize(line)));
+    });
+    
+    // Every account is already parsed, so the saved totals are checked too
+    std::lock_guard<std::mutex> lock(writeMutex);
+    rebuildAccountFilter(*next);
+    loadPortfolios(*next, contentsChecksum(contents), true);
+    publish(next, table.load()->records);
+}
+
+template <typename Backend>
+void BasicBank<Backend>::openAccounts() {
+    stopWarmer();
+    std::string contents = backend.read(ACCOUNTS_FILE);
+    uint64_t checksum = contentsChecksum(contents);
+    std::shared_ptr<const AccountIndex> index = std::make_shared<AccountIndex>(std::move(contents));
+    AccountTable* next = new AccountTable();
+    next->records.assign(index->size(), nullptr);
+    next->index = index;
+    
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        rebuildAccountFilter(*next);
+        loadPortfolios(*next, checksum, false);
+        publish(next, table.load()->records);
+    }
+    
+    // Hydrate the rest in the background; readers get there first for the
+    // accounts they touch
+    stopWarming = false;
+    warmer = std::thread([this, index]() {
+        for (size_t i = 0; i < index->size() && !stopWarming.load(std::memory_order_relaxed); ++i) {
+            index->hydrate(i);
+        }
+    });
+}
+
+template <typename Backend>
+void BasicBank<Backend>::stopWarmer() {
+    if (warmer.joinable()) {
+        stopWarming = true;
+        warmer.join();
+    }
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::saveAccounts() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return saveTable(*table.load());
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::saveTable(const AccountTable& accounts) {
+    // Unchanged accounts are written back as they were read
+    std::string contents;
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        if (accounts.records[i] != nullptr) {
+            contents += accounts.records[i]->serialize();
+        } else {
+            contents += accounts.index->lineAt(i);
+        }
+        contents += '\n';
+    }
+    accountsChecksum = contentsChecksum(contents);
+    bool saved = backend.write(ACCOUNTS_FILE, std::move(contents), durability);
+    return savePortfolios() && saved;
+}
+
+template <typename Backend>
+void BasicBank<Backend>::adjustPortfolio(int userId, double balanceDelta, size_t accountsAdded) {
+    std::lock_guard<std::mutex> lock(portfolioMutex);
+    PortfolioSummary& summary = portfolios[userId];
+    summary.userId = userId;
+    summary.totalBalance += balanceDelta;
+    summary.accountCount += accountsAdded;
+    summary.lastActivity = time(nullptr);
+    changedPortfolios.insert(userId);
+}
+
+template <typename Backend>
+std::unordered_map<int, PortfolioSummary> BasicBank<Backend>::computePortfolios(const AccountTable& accounts) {
+    std::unordered_map<int, PortfolioSummary> computed;
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        PortfolioSummary& summary = computed[accounts.userIdAt(i)];
+        summary.userId = accounts.userIdAt(i);
+        summary.totalBalance += accounts.at(i).getBalance();
+        summary.accountCount++;
+    }
+    return computed;
+}
+
+template <typename Backend>
+void BasicBank<Backend>::loadPortfolios(const AccountTable& accounts, uint64_t checksum, bool checkTotals) {
+    // The first line names the accounts file the summaries were saved with
+    std::unordered_map<int, PortfolioSummary> loaded;
+    std::string contents = backend.read(PORTFOLIOS_FILE);
+    std::string_view rest = contents;
+    std::string_view header = nextField(rest, '\n');
+    uint64_t savedChecksum = 0;
+    bool consistent = nextField(header, ',') == "accounts" && parseNumber(header, savedChecksum) &&
+                      savedChecksum == checksum;
+    forEachLine(rest, [&loaded](std::string_view line) {
+        PortfolioSummary summary = PortfolioSummary::deserialize(line);
+        loaded[summary.userId] = summary;
+    });
+    
+    // With every account parsed the totals cost nothing to confirm
+    std::unordered_map<int, PortfolioSummary> computed;
+    if (consistent && checkTotals) {
+        computed = computePortfolios(accounts);
+        consistent = computed.size() == loaded.size();
+        for (const auto& entry : computed) {
+            auto it = loaded.find(entry.first);
+            if (it == loaded.end() || it->second.accountCount != entry.second.accountCount ||
+                std::fabs(it->second.totalBalance - entry.second.totalBalance) >= 0.005) {
+                consistent = false;
             }
         }
-        file.close();
     }
+    
+    // Stale totals are recomputed, which hydrates every account
+    if (!consistent) {
+        if (computed.empty()) {
+            computed = computePortfolios(accounts);
+        }
+        for (auto& entry : computed) {
+            auto it = loaded.find(entry.first);
+            entry.second.lastActivity = it == loaded.end() ? 0 : it->second.lastActivity;
+        }
+        loaded = std::move(computed);
+    }
+    accountsChecksum = checksum;
+    replacePortfolios(std::move(loaded));
 }
 
-void Bank::saveAccounts() {
-    std::ofstream file("accounts.csv");
-    if (file.is_open()) {
-        for (const auto& account : accounts) {
-            file << account.serialize() << std::endl;
+template <typename Backend>
+void BasicBank<Backend>::replacePortfolios(std::unordered_map<int, PortfolioSummary> summaries) {
+    std::lock_guard<std::mutex> lock(portfolioMutex);
+    portfolios = std::move(summaries);
+    portfolioLines.clear();
+    changedPortfolios.clear();
+    for (const auto& entry : portfolios) {
+        changedPortfolios.insert(entry.first);
+    }
+}
+
+template <typename Backend>
+bool BasicBank<Backend>::savePortfolios() {
+    // Only summaries changed since the last save are serialized again
+    std::string contents = "accounts," + std::to_string(accountsChecksum) + "\n";
+    {
+        std::lock_guard<std::mutex> lock(portfolioMutex);
+        for (int userId : changedPortfolios) {
+            portfolioLines[userId] = portfolios[userId].serialize();
+        }
+        changedPortfolios.clear();
+        for (const auto& entry : portfolioLines) {
+            contents += entry.second;
+            contents += '\n';
+        }
+    }
+    return backend.write(PORTFOLIOS_FILE, std::move(contents), durability);
+}
+
+template <typename Backend>
+PortfolioSummary BasicBank<Backend>::getPortfolio(int userId) const {
+    std::lock_guard<std::mutex> lock(portfolioMutex);
+    auto it = portfolios.find(userId);
+    if (it == portfolios.end()) {
+        PortfolioSummary empty;
+        empty.userId = userId;
+        return empty;
+    }
+    return it->second;
+}
+
+template <typename Backend>
+std::vector<int> BasicBank<Backend>::verifyPortfolios() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::unordered_map<int, PortfolioSummary> expected = computePortfolios(*table.load());
+    
+    // Totals are sums of doubles, so allow them to differ by under a cent
+    std::vector<int> drifted;
+    std::lock_guard<std::mutex> portfolioLock(portfolioMutex);
+    for (const auto& entry : expected) {
+        auto it = portfolios.find(entry.first);
+        if (it == portfolios.end() || it->second.accountCount != entry.second.accountCount ||
+            std::fabs(it->second.totalBalance - entry.second.totalBalance) >= 0.005) {
+            drifted.push_back(entry.first);
+        }
+    }
+    for (const auto& entry : portfolios) {
+        if (entry.second.accountCount > 0 && expected.find(entry.first) == expected.end()) {
+            drifted.push_back(entry.first);
+        }
+    }
+    std::sort(drifted.begin(), drifted.end());
+    return drifted;
+}
+
+template <typename Backend>
+void BasicBank<Backend>::rebuildPortfolios() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::unordered_map<int, PortfolioSummary> computed = computePortfolios(*table.load());
+    {
+        std::lock_guard<std::mutex> portfolioLock(portfolioMutex);
+        for (auto& entry : computed) {
+            auto it = portfolios.find(entry.first);
+            entry.second.lastActivity = it == portfolios.end() ? 0 : it->second.lastActivity;
         }
-        file.close();
     }
-}
\ No newline at end of file
+    replacePortfolios(std::move(computed));
+    savePortfolios();
+}
+
+template <typename Backend>
+void BasicBank<Backend>::rebuildAccountFilter(const AccountTable& accounts) {
+    // Leave room to grow before the next rebuild
+    BloomFilter filter(std::max<uint64_t>(1024, accounts.size() * 2));
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        filter.add(accounts.idAt(i));
+    }
+    filter.copyStats(accountFilter);
+    accountFilter = std::move(filter);
+}
+
+template <typename Backend>
+BloomFilterStats BasicBank<Backend>::getAccountFilterStats() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return accountFilter.getStats();
+}
+
+template <typename Backend>
+void BasicBank<Backend>::setDurability(Durability mode) {
+    durability = mode;
+}
+
+// Backends available to BasicBank
+template class BasicBank<CsvBackend>;
+template class BasicBank<MemoryBackend>;
+template class BasicBank<LogBackend>;
\ No newline at end of file
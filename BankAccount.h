@@ -2,8 +2,19 @@
 #define BANK_ACCOUNT_H
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <ctime>
+#include <unordered_map>
+#include <unordered_set>
+#include "EpochManager.h"
+#include "BloomFilter.h"
+#include "StorageBackend.h"
 
 // Bank Account class
 class BankAccount {
@@ -15,12 +26,12 @@ private:
 
 public:
     // Constructor
-    BankAccount(int userId, const std::string& accountId, const std::string& name, double initialBalance = 0.0);
+    BankAccount(int userId, std::string accountId, std::string name, double initialBalance = 0.0);
     
     // Getters
     int getUserId() const;
-    std::string getAccountId() const;
-    std::string getName() const;
+    const std::string& getAccountId() const;
+    const std::string& getName() const;
     double getBalance() const;
     
     // Operations
@@ -30,29 +41,224 @@ public:
     
     // Serialization for storage
     std::string serialize() const;
-    static BankAccount deserialize(const std::string& data);
+    static BankAccount deserialize(std::string_view data);
 };
 
-// Bank class to manage multiple accounts
-class Bank {
+// Per-user totals across all of a user's accounts
+struct PortfolioSummary {
+    int userId = 0;
+    double totalBalance = 0;
+    size_t accountCount = 0;
+    time_t lastActivity = 0;    // Last new account or balance change
+    
+    // Serialization for storage
+    std::string serialize() const;
+    static PortfolioSummary deserialize(std::string_view data);
+};
+
+// Accounts file as loaded at startup: the raw contents plus an offset index
+// of account and user ids. Records are deserialized on first access and kept
+// for the life of the index.
+class AccountIndex {
 private:
-    std::vector<BankAccount> accounts;
+    struct Entry {
+        std::string_view accountId;
+        int userId = 0;
+        std::string_view line;
+        mutable std::atomic<const BankAccount*> record{nullptr};
+    };
     
+    std::string contents;
+    std::vector<Entry> entries;
+
 public:
-    // Add an account
-    void addAccount(const BankAccount& account);
+    explicit AccountIndex(std::string data);
+    ~AccountIndex();
+    
+    AccountIndex(const AccountIndex&) = delete;
+    AccountIndex& operator=(const AccountIndex&) = delete;
+    
+    size_t size() const { return entries.size(); }
+    std::string_view accountIdAt(size_t i) const { return entries[i].accountId; }
+    int userIdAt(size_t i) const { return entries[i].userId; }
+    std::string_view lineAt(size_t i) const { return entries[i].line; }
+    
+    // Deserialize the record on first use; safe to race
+    const BankAccount& hydrate(size_t i) const;
+};
+
+// Bank class to manage multiple accounts, parameterized on the storage backend.
+//
+// Accounts are published as immutable tables. Writers copy the table, swap in
+// new account records and publish it; readers take a Snapshot, which sees one
+// point-in-time table without locking. Replaced tables and records are freed
+// through epoch-based reclamation once no snapshot can reach them.
+//
+// Per-user portfolio aggregates are updated by every write and persisted
+// next to the accounts, so getPortfolio() never scans. The saved summaries
+// carry a checksum of the accounts file they match; on load, a mismatch
+// means the two files were not saved together and the totals are
+// recomputed.
+//
+// openAccounts() builds only an AccountIndex; table slots the bank has not
+// written since then point into it and are hydrated on first access, while a
+// background thread warms the rest.
+template <typename Backend>
+class BasicBank {
+private:
+    // Slots without a record have not changed since the accounts were opened
+    // and are read from the index
+    struct AccountTable {
+        std::vector<const BankAccount*> records;
+        std::shared_ptr<const AccountIndex> index;
+        
+        size_t size() const { return records.size(); }
+        std::string_view idAt(size_t i) const {
+            return records[i] != nullptr ? std::string_view(records[i]->getAccountId()) : index->accountIdAt(i);
+        }
+        int userIdAt(size_t i) const {
+            return records[i] != nullptr ? records[i]->getUserId() : index->userIdAt(i);
+        }
+        const BankAccount& at(size_t i) const {
+            return records[i] != nullptr ? *records[i] : index->hydrate(i);
+        }
+    };
+    
+    const std::string ACCOUNTS_FILE = "accounts.csv";
+    const std::string PORTFOLIOS_FILE = "portfolios.csv";
+    std::atomic<const AccountTable*> table;
+    mutable EpochManager epochs;
+    std::mutex writeMutex;      // Serializes writers
+    BloomFilter accountFilter;  // Account ids, maintained by writers
+    Durability durability = Durability::Async;
+    Backend backend;
+    mutable std::mutex portfolioMutex;  // Taken after writeMutex
+    std::unordered_map<int, PortfolioSummary> portfolios;
+    std::unordered_map<int, std::string> portfolioLines;    // Serialized summaries
+    std::unordered_set<int> changedPortfolios;               // Lines to reserialize
+    uint64_t accountsChecksum = 0;      // Of the saved accounts file; under writeMutex
+    std::thread warmer;
+    std::atomic<bool> stopWarming{false};
+    
+    static const BankAccount* findIn(const AccountTable& accounts, std::string_view accountId);
+    
+    // Publish a new table and retire the old one together with the records
+    // it no longer shares. Caller holds writeMutex.
+    void publish(AccountTable* next, std::vector<const BankAccount*> replaced);
+    
+    // Apply an update to one account under the write lock
+    template <typename Update>
+    bool modifyAccount(std::string_view accountId, Update&& update);
+    
+    bool saveTable(const AccountTable& accounts);
+    void rebuildAccountFilter(const AccountTable& accounts);
     
-    // Find account by ID
-    BankAccount* findAccount(const std::string& accountId);
+    // Portfolio maintenance; callers hold writeMutex
+    void adjustPortfolio(int userId, double balanceDelta, size_t accountsAdded);
+    void loadPortfolios(const AccountTable& accounts, uint64_t checksum, bool checkTotals);
+    void replacePortfolios(std::unordered_map<int, PortfolioSummary> summaries);
+    bool savePortfolios();
+    static std::unordered_map<int, PortfolioSummary> computePortfolios(const AccountTable& accounts);
+    void stopWarmer();
+    
+public:
+    // Point-in-time, read-only view of every account
+    class Snapshot {
+    private:
+        EpochManager::Guard guard;
+        const AccountTable* accounts;
+        
+    public:
+        Snapshot(EpochManager& epochs, const std::atomic<const AccountTable*>& table)
+            : guard(epochs), accounts(table.load()) {}
+        
+        const BankAccount* find(std::string_view accountId) const {
+            return findIn(*accounts, accountId);
+        }
+        
+        size_t size() const {
+            return accounts->size();
+        }
+        
+        template <typename Visitor>
+        void forEachAccount(Visitor&& visit) const {
+            for (size_t i = 0; i < accounts->size(); ++i) {
+                visit(accounts->at(i));
+            }
+        }
+        
+        template <typename Visitor>
+        void forEachAccountOfUser(int userId, Visitor&& visit) const {
+            for (size_t i = 0; i < accounts->size(); ++i) {
+                if (accounts->userIdAt(i) == userId) {
+                    visit(accounts->at(i));
+                }
+            }
+        }
+    };
+    
+    BasicBank();
+    ~BasicBank();
+    
+    BasicBank(const BasicBank&) = delete;
+    BasicBank& operator=(const BasicBank&) = delete;
+    
+    // Consistent view for readers; never blocks writers
+    Snapshot snapshot() const;
+    
+    // Add an account; false if the account id is already taken or the
+    // accounts could not be persisted
+    bool addAccount(BankAccount account);
+    
+    // Transactions; each publishes a new version and persists it. False if
+    // the transaction was refused or persisting it failed; a failed write
+    // still leaves the new version published.
+    bool deposit(std::string_view accountId, double amount);
+    bool withdraw(std::string_view accountId, double amount);
+    bool transfer(std::string_view fromAccountId, std::string_view toAccountId, double amount);
+    
+    // Balance of an account, or -1 if it does not exist
+    double getBalance(std::string_view accountId) const;
     
     // Find accounts by user ID
-    std::vector<BankAccount> findAccountsByUserId(int userId);
+    std::vector<BankAccount> findAccountsByUserId(int userId) const;
+    
+    // Visit a user's accounts in place, without copying them
+    template <typename Visitor>
+    void forEachAccountOfUser(int userId, Visitor&& visit) const {
+        snapshot().forEachAccountOfUser(userId, std::forward<Visitor>(visit));
+    }
     
     // Load all accounts from storage
     void loadAccounts();
     
-    // Save all accounts to storage
-    void saveAccounts();
+    // Index the accounts without deserializing them; records are hydrated
+    // on first access and by a background warm-up thread
+    void openAccounts();
+    
+    // Save all accounts to storage; false if the write failed
+    bool saveAccounts();
+    
+    // A user's totals as of the latest write, in O(1); zeroed if the user
+    // has no accounts
+    PortfolioSummary getPortfolio(int userId) const;
+    
+    // Recompute every portfolio from the accounts and return the users whose
+    // maintained totals or account counts have drifted
+    std::vector<int> verifyPortfolios();
+    
+    // Replace the maintained totals with recomputed ones, keeping activity
+    // times, and persist them
+    void rebuildPortfolios();
+    
+    // Effectiveness of the account id filter used by addAccount
+    BloomFilterStats getAccountFilterStats();
+    
+    // Whether saveAccounts waits for the write to be fsynced
+    void setDurability(Durability mode);
 };
 
+// Default bank over CSV files
+using Bank = BasicBank<CsvBackend>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "BloomFilter.h"
+#include "Storage.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+uint64_t fnv1a(std::string_view key, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ULL ^ seed;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    // Final avalanche so nearby keys spread across the filter
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+} // namespace
+
+// BloomFilter implementation
+BloomFilter::BloomFilter(uint64_t expectedItems, double falsePositiveRate)
+    : capacity(expectedItems > 0 ? expectedItems : 1), items(0), checks(0), maybePresent(0), falsePositives(0) {
+    const double ln2 = std::log(2.0);
+    double bits = -static_cast<double>(capacity) * std::log(falsePositiveRate) / (ln2 * ln2);
+    bitCount = std::max<uint64_t>(64, static_cast<uint64_t>(std::ceil(bits / 64)) * 64);
+    hashCount = std::max(1u, static_cast<unsigned>(std::lround(bitCount / static_cast<double>(capacity) * ln2)));
+    words.assign(bitCount / 64, 0);
+}
+
+void BloomFilter::add(std::string_view key) {
+    // Double hashing: h1 + i * h2
+    uint64_t h1 = fnv1a(key, 0);
+    uint64_t h2 = fnv1a(key, 0x9e3779b97f4a7c15ULL) | 1;
+    for (unsigned i = 0; i < hashCount; ++i) {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        words[bit / 64] |= 1ULL << (bit % 64);
+    }
+    items++;
+}
+
+bool BloomFilter::mightContain(std::string_view key) {
+    checks++;
+    uint64_t h1 = fnv1a(key, 0);
+    uint64_t h2 = fnv1a(key, 0x9e3779b97f4a7c15ULL) | 1;
+    for (unsigned i = 0; i < hashCount; ++i) {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        if ((words[bit / 64] & (1ULL << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    maybePresent++;
+    return true;
+}
+
+void BloomFilter::recordFalsePositive() {
+    falsePositives++;
+}
+
+void BloomFilter::copyStats(const BloomFilter& other) {
+    checks = other.checks;
+    maybePresent = other.maybePresent;
+    falsePositives = other.falsePositives;
+}
+
+bool BloomFilter::isOverloaded() const {
+    return items > capacity;
+}
+
+uint64_t BloomFilter::getCapacity() const {
+    return capacity;
+}
+
+uint64_t BloomFilter::getItemCount() const {
+    return items;
+}
+
+BloomFilterStats BloomFilter::getStats() const {
+    BloomFilterStats stats;
+    stats.items = items;
+    stats.bits = bitCount;
+    stats.checks = checks;
+    stats.maybePresent = maybePresent;
+    stats.falsePositives = falsePositives;
+    // Only lookups for absent keys can be false positives
+    uint64_t absent = checks - (maybePresent - falsePositives);
+    stats.observedFalsePositiveRate = absent > 0 ? static_cast<double>(falsePositives) / absent : 0;
+    stats.estimatedFalsePositiveRate = std::pow(1 - std::exp(-static_cast<double>(hashCount) * items / bitCount), hashCount);
+    return stats;
+}
+
+std::string BloomFilter::serialize() const {
+    // capacity,hashes,items,bits then the bit array in hex
+    std::stringstream ss;
+    ss << capacity << "," << hashCount << "," << items << "," << bitCount << "\n";
+    char word[17];
+    for (uint64_t value : words) {
+        std::snprintf(word, sizeof(word), "%016llx", static_cast<unsigned long long>(value));
+        ss << word;
+    }
+    ss << "\n";
+    return ss.str();
+}
+
+bool BloomFilter::deserialize(std::string_view data, BloomFilter& filter) {
+    std::string_view header = nextField(data, '\n');
+    std::string_view hex = nextField(data, '\n');
+    uint64_t capacity = parseNumber<uint64_t>(nextField(header, ','));
+    unsigned hashCount = parseNumber<unsigned>(nextField(header, ','));
+    uint64_t items = parseNumber<uint64_t>(nextField(header, ','));
+    uint64_t bitCount = parseNumber<uint64_t>(nextField(header, ','));
+    if (capacity == 0 || hashCount == 0 || bitCount == 0 || bitCount % 64 != 0 || hex.size() != bitCount / 4) {
+        return false;
+    }
+
+    std::vector<uint64_t> words(bitCount / 64);
+    for (size_t i = 0; i < words.size(); ++i) {
+        std::string_view digits = hex.substr(i * 16, 16);
+        auto result = std::from_chars(digits.data(), digits.data() + digits.size(), words[i], 16);
+        if (result.ec != std::errc() || result.ptr != digits.data() + digits.size()) {
+            return false;
+        }
+    }
+
+    filter = BloomFilter(capacity);
+    filter.words = std::move(words);
+    filter.bitCount = bitCount;
+    filter.hashCount = hashCount;
+    filter.items = items;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Counters describing how well a filter is doing
+struct BloomFilterStats {
+    uint64_t items = 0;             // Keys added
+    uint64_t bits = 0;              // Filter size
+    uint64_t checks = 0;            // Lookups answered
+    uint64_t maybePresent = 0;      // Lookups that needed an exact check
+    uint64_t falsePositives = 0;    // Exact checks that found nothing
+    double observedFalsePositiveRate = 0;
+    double estimatedFalsePositiveRate = 0;
+};
+
+// Bloom filter over string keys. A negative answer is definite; a positive
+// answer has to be confirmed by an exact lookup.
+class BloomFilter {
+private:
+    std::vector<uint64_t> words;
+    uint64_t bitCount;
+    unsigned hashCount;
+    uint64_t capacity;
+    uint64_t items;
+    uint64_t checks;
+    uint64_t maybePresent;
+    uint64_t falsePositives;
+
+public:
+    // Sized for expectedItems keys at the target false-positive rate
+    explicit BloomFilter(uint64_t expectedItems = 1024, double falsePositiveRate = 0.01);
+
+    void add(std::string_view key);
+    bool mightContain(std::string_view key);
+    void recordFalsePositive();
+
+    // Keep lookup counters across a rebuild
+    void copyStats(const BloomFilter& other);
+
+    // More keys than the filter was sized for; rebuild it larger
+    bool isOverloaded() const;
+    uint64_t getCapacity() const;
+    uint64_t getItemCount() const;
+    BloomFilterStats getStats() const;
+
+    // Serialization for storage
+    std::string serialize() const;
+    static bool deserialize(std::string_view data, BloomFilter& filter);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "EpochManager.h"
+#include <functional>
+#include <thread>
+
+// Guard implementation
+EpochManager::Guard::Guard(EpochManager& manager) : manager(&manager), slot(manager.pin()) {}
+
+EpochManager::Guard::Guard(Guard&& other) noexcept : manager(other.manager), slot(other.slot) {
+    other.manager = nullptr;
+}
+
+EpochManager::Guard::~Guard() {
+    if (manager != nullptr) {
+        manager->unpin(slot);
+    }
+}
+
+// EpochManager implementation
+EpochManager::~EpochManager() {
+    // No readers remain once the owner is destroyed
+    for (const auto& entry : retired) {
+        entry.destroy(entry.object);
+    }
+}
+
+size_t EpochManager::pin() {
+    // Start probing at a per-thread position so threads rarely contend
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % MAX_READERS;
+    while (true) {
+        for (size_t i = 0; i < MAX_READERS; ++i) {
+            size_t index = (start + i) % MAX_READERS;
+            uint64_t expected = 0;
+            uint64_t epoch = globalEpoch.load();
+            if (slots[index].epoch.compare_exchange_strong(expected, epoch)) {
+                return index;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void EpochManager::unpin(size_t slot) {
+    slots[slot].epoch.store(0, std::memory_order_release);
+}
+
+void EpochManager::retireObject(void* object, void (*destroy)(void*)) {
+    // Readers that pinned at or before this epoch may still hold the object;
+    // anyone pinning afterwards sees its replacement
+    uint64_t epoch = globalEpoch.fetch_add(1);
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    retired.push_back({object, destroy, epoch});
+    if (retired.size() >= 32) {
+        reclaimLocked();
+    }
+}
+
+void EpochManager::reclaim() {
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    reclaimLocked();
+}
+
+void EpochManager::reclaimLocked() {
+    uint64_t oldest = UINT64_MAX;
+    for (const auto& slot : slots) {
+        uint64_t epoch = slot.epoch.load();
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i) {
+        if (retired[i].epoch < oldest) {
+            retired[i].destroy(retired[i].object);
+        } else {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+}
@@ -0,0 +1,72 @@
+#ifndef EPOCH_MANAGER_H
+#define EPOCH_MANAGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation for data published to lock-free readers.
+//
+// Readers pin the current epoch for as long as they hold pointers to shared
+// data. Writers publish a replacement, then retire the old object; it is
+// deleted once every reader that could still see it has unpinned.
+class EpochManager {
+private:
+    static const size_t MAX_READERS = 128;
+
+    // 0 = free, otherwise the epoch the reader pinned
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    struct Retired {
+        void* object;
+        void (*destroy)(void*);
+        uint64_t epoch;
+    };
+
+    std::atomic<uint64_t> globalEpoch{1};
+    Slot slots[MAX_READERS];
+    std::mutex retiredMutex;
+    std::vector<Retired> retired;
+
+    size_t pin();
+    void unpin(size_t slot);
+    void retireObject(void* object, void (*destroy)(void*));
+    void reclaimLocked();
+
+public:
+    // Keeps the epoch pinned while in scope
+    class Guard {
+    private:
+        EpochManager* manager;
+        size_t slot;
+
+    public:
+        explicit Guard(EpochManager& manager);
+        Guard(Guard&& other) noexcept;
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+        ~Guard();
+    };
+
+    EpochManager() = default;
+    ~EpochManager();
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // Delete an unpublished object once no pinned reader can reach it
+    template <typename T>
+    void retire(const T* object) {
+        retireObject(const_cast<T*>(object), [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    // Free retired objects that no reader can still hold
+    void reclaim();
+};
+
+#endif
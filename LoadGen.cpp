@@ -0,0 +1,179 @@
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "Workload.h"
+
+// Load generator for the banking core
+//
+//   loadgen [register|login|validate|mix|surge] [options]
+//   loadgen replay <trace> [options]
+//
+// Options:
+//   --threads N      worker threads (generated workloads)
+//   --ops N          timed operations per thread
+//   --seed S         generator seed
+//   --users N        registered users for login/validate/mix
+//   --hot N          hot accounts for the transaction mix
+//   --fail-rate F    fraction of logins with a wrong password
+//   --zipf S         Zipf skew over hot accounts
+//   --deposit F      deposit share of the transaction mix
+//   --withdraw F     withdraw share of the transaction mix
+//   --record FILE    write the generated trace before running
+//   --durability M   async (default) or wait for fsync on every persisting call
+//   --backend B      csv (default), memory or log storage backend
+//   --scheduler N    run operations on an N-worker priority scheduler
+//   --dir PATH       run inside PATH (storage files are created there)
+//   --fresh          remove existing storage files before running
+//   --dry-run        generate and record without executing
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: loadgen [register|login|validate|mix|surge] [--threads N] [--ops N] [--seed S]\n"
+              << "               [--users N] [--hot N] [--fail-rate F] [--zipf S]\n"
+              << "               [--deposit F] [--withdraw F] [--record FILE]\n"
+              << "               [--durability async|wait] [--backend csv|memory|log]\n"
+              << "               [--scheduler N] [--dir PATH] [--fresh] [--dry-run]\n"
+              << "       loadgen replay <trace> [--durability async|wait] [--backend csv|memory|log]\n"
+              << "                      [--scheduler N] [--dir PATH] [--fresh]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    WorkloadConfig config;
+    std::string replayFile;
+    std::string recordFile;
+    std::string directory;
+    bool fresh = false;
+    bool dryRun = false;
+    Durability durability = Durability::Async;
+    std::string backend = "csv";
+    int schedulerWorkers = 0;
+
+    int i = 1;
+    if (i < argc && argv[i][0] != '-') {
+        config.scenario = argv[i++];
+        if (config.scenario == "replay") {
+            if (i >= argc) {
+                printUsage();
+                return 1;
+            }
+            replayFile = argv[i++];
+        } else if (config.scenario != "register" && config.scenario != "login" &&
+                   config.scenario != "validate" && config.scenario != "mix" && config.scenario != "surge") {
+            printUsage();
+            return 1;
+        }
+    }
+
+    try {
+        for (; i < argc; ++i) {
+            std::string option = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (option == "--fresh") {
+                fresh = true;
+            } else if (option == "--dry-run") {
+                dryRun = true;
+            } else if (!hasValue) {
+                printUsage();
+                return 1;
+            } else if (option == "--threads") {
+                config.threads = std::stoi(argv[++i]);
+            } else if (option == "--ops") {
+                config.operations = std::stoi(argv[++i]);
+            } else if (option == "--seed") {
+                config.seed = std::stoull(argv[++i]);
+            } else if (option == "--users") {
+                config.users = std::stoi(argv[++i]);
+            } else if (option == "--hot") {
+                config.hotAccounts = std::stoi(argv[++i]);
+            } else if (option == "--fail-rate") {
+                config.loginFailureRate = std::stod(argv[++i]);
+            } else if (option == "--zipf") {
+                config.zipfSkew = std::stod(argv[++i]);
+            } else if (option == "--deposit") {
+                config.depositRatio = std::stod(argv[++i]);
+            } else if (option == "--withdraw") {
+                config.withdrawRatio = std::stod(argv[++i]);
+            } else if (option == "--record") {
+                recordFile = argv[++i];
+            } else if (option == "--durability") {
+                std::string mode = argv[++i];
+                if (mode != "async" && mode != "wait") {
+                    printUsage();
+                    return 1;
+                }
+                durability = mode == "wait" ? Durability::Wait : Durability::Async;
+            } else if (option == "--backend") {
+                backend = argv[++i];
+                if (backend != "csv" && backend != "memory" && backend != "log") {
+                    printUsage();
+                    return 1;
+                }
+            } else if (option == "--scheduler") {
+                schedulerWorkers = std::stoi(argv[++i]);
+                if (schedulerWorkers < 0) {
+                    printUsage();
+                    return 1;
+                }
+            } else if (option == "--dir") {
+                directory = argv[++i];
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage();
+        return 1;
+    }
+
+    Workload workload;
+    if (!replayFile.empty()) {
+        if (!Workload::load(replayFile, workload)) {
+            std::cerr << "Could not read trace " << replayFile << std::endl;
+            return 1;
+        }
+    } else {
+        workload = Workload::generate(config);
+    }
+
+    if (!recordFile.empty() && !workload.save(recordFile)) {
+        std::cerr << "Could not write trace " << recordFile << std::endl;
+        return 1;
+    }
+    if (dryRun) {
+        std::cout << "Generated " << workload.getOperations().size() << " operations for "
+                  << workload.getThreadCount() << " threads\n";
+        return 0;
+    }
+
+    if (!directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::filesystem::current_path(directory, error);
+        if (error) {
+            std::cerr << "Could not enter " << directory << ": " << error.message() << std::endl;
+            return 1;
+        }
+    }
+    if (fresh) {
+        std::remove("users.csv");
+        std::remove("sessions.csv");
+        std::remove("accounts.csv");
+        std::remove("portfolios.csv");
+        std::remove("users.bloom");
+        std::remove("users.bloom.log");
+        std::remove("users.csv.log");
+        std::remove("sessions.csv.log");
+        std::remove("accounts.csv.log");
+        std::remove("portfolios.csv.log");
+    }
+
+    std::cout << "Running " << workload.getOperations().size() << " operations on "
+              << workload.getThreadCount() << " threads\n";
+    printReport(workload.run(durability, backend, static_cast<size_t>(schedulerWorkers)));
+    return 0;
+}
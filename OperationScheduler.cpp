@@ -0,0 +1,283 @@
+#include "OperationScheduler.h"
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <utility>
+
+namespace {
+
+// Increment counter unless it has reached limit
+bool incrementBelow(std::atomic<int>& counter, int limit) {
+    int current = counter.load();
+    while (current < limit) {
+        if (counter.compare_exchange_weak(current, current + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t toNanos(double micros) {
+    return static_cast<uint64_t>(micros * 1000);
+}
+
+} // namespace
+
+const char* priorityName(Priority priority) {
+    switch (priority) {
+        case Priority::Interactive: return "interactive";
+        case Priority::Transaction: return "transaction";
+        case Priority::Authentication: return "auth";
+        case Priority::Batch: return "batch";
+    }
+    return "unknown";
+}
+
+// OperationScheduler implementation
+OperationScheduler::OperationScheduler(size_t workerCount) : stopping(false) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int pool = static_cast<int>(workerCount);
+
+    // Hold back a quarter of the pool for Interactive work
+    int reserved = pool > 1 ? std::max(1, pool / 4) : 0;
+    backgroundBudget = pool - reserved;
+
+    PriorityBudget interactive{pool, 2000, 4096};
+    PriorityBudget transaction{backgroundBudget, 20000, 4096};
+    PriorityBudget authentication{std::max(1, pool / 2), 250000, 1024};
+    PriorityBudget batch{std::max(1, pool / 4), 5000000, 64};
+    for (size_t i = 0; i < workerCount; ++i) {
+        queues.emplace_back(new WorkerQueues());
+    }
+    setBudget(Priority::Interactive, interactive);
+    setBudget(Priority::Transaction, transaction);
+    setBudget(Priority::Authentication, authentication);
+    setBudget(Priority::Batch, batch);
+
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&OperationScheduler::workerLoop, this, i);
+    }
+}
+
+OperationScheduler::~OperationScheduler() {
+    shutdown();
+}
+
+void OperationScheduler::shutdown() {
+    // Queued work still runs; new submissions are refused
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void OperationScheduler::setBudget(Priority priority, const PriorityBudget& budget) {
+    ClassState& state = classes[static_cast<size_t>(priority)];
+    int pool = static_cast<int>(queues.size());
+    int limit = priority == Priority::Interactive ? pool : backgroundBudget;
+    state.workerBudget = std::min(std::max(budget.workers, 1), std::max(limit, 1));
+    state.latencyTargetNanos = toNanos(budget.latencyTargetMicros);
+    state.maxQueued = budget.maxQueued;
+    signalWork();
+}
+
+PriorityBudget OperationScheduler::getBudget(Priority priority) const {
+    const ClassState& state = classes[static_cast<size_t>(priority)];
+    PriorityBudget budget;
+    budget.workers = state.workerBudget.load();
+    budget.latencyTargetMicros = state.latencyTargetNanos.load() / 1000.0;
+    budget.maxQueued = state.maxQueued.load();
+    return budget;
+}
+
+bool OperationScheduler::submit(Priority priority, std::function<void()> task) {
+    size_t index = static_cast<size_t>(priority);
+    ClassState& state = classes[index];
+    state.submitted.fetch_add(1, std::memory_order_relaxed);
+
+    // Admission control: expected wait is the work ahead of us spread over
+    // the workers this class may use
+    size_t depth = state.queued.fetch_add(1);
+    uint64_t expectedWait = depth * state.serviceNanos.load(std::memory_order_relaxed) / state.workerBudget.load();
+    if (depth >= state.maxQueued.load() || expectedWait > state.latencyTargetNanos.load()) {
+        state.queued.fetch_sub(1);
+        state.shed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Counted under the same lock as the stopping check, so shutdown either
+    // refuses the task or keeps its workers until the task has run
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        if (stopping) {
+            state.queued.fetch_sub(1);
+            state.shed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queuedTotal.fetch_add(1);
+    }
+
+    WorkerQueues& target = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.tasks[index].push_back({std::move(task), Clock::now()});
+    }
+    signalWork();
+    return true;
+}
+
+bool OperationScheduler::call(Priority priority, const std::function<void()>& task) {
+    std::promise<void> done;
+    std::future<void> finished = done.get_future();
+    if (!submit(priority, [&task, &done]() {
+            try {
+                task();
+                done.set_value();
+            } catch (...) {
+                done.set_exception(std::current_exception());
+            }
+        })) {
+        return false;
+    }
+    finished.get();
+    return true;
+}
+
+SchedulerStats OperationScheduler::getStats(Priority priority) const {
+    const ClassState& state = classes[static_cast<size_t>(priority)];
+    SchedulerStats stats;
+    stats.submitted = state.submitted.load();
+    stats.shed = state.shed.load();
+    stats.completed = state.completed.load();
+    stats.failed = state.failed.load();
+    stats.stolen = state.stolen.load();
+    stats.averageWaitMicros = stats.completed > 0 ? state.waitNanos.load() / 1000.0 / stats.completed : 0;
+    stats.maxWaitMicros = state.maxWaitNanos.load() / 1000.0;
+    return stats;
+}
+
+size_t OperationScheduler::getWorkerCount() const {
+    return queues.size();
+}
+
+void OperationScheduler::signalWork() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        generation.fetch_add(1);
+    }
+    // While shutting down every idle worker has to recheck whether to exit
+    if (stopping.load()) {
+        workAvailable.notify_all();
+    } else {
+        workAvailable.notify_one();
+    }
+}
+
+bool OperationScheduler::acquire(size_t priority) {
+    ClassState& state = classes[priority];
+    if (!incrementBelow(state.running, state.workerBudget.load())) {
+        return false;
+    }
+    if (priority != static_cast<size_t>(Priority::Interactive) &&
+        !incrementBelow(backgroundRunning, backgroundBudget)) {
+        state.running.fetch_sub(1);
+        return false;
+    }
+    return true;
+}
+
+void OperationScheduler::release(size_t priority) {
+    if (priority != static_cast<size_t>(Priority::Interactive)) {
+        backgroundRunning.fetch_sub(1);
+    }
+    classes[priority].running.fetch_sub(1);
+}
+
+bool OperationScheduler::takeTask(size_t self, Task& task, size_t& priority) {
+    for (size_t p = 0; p < CLASS_COUNT; ++p) {
+        if (classes[p].queued.load() == 0 || !acquire(p)) {
+            continue;
+        }
+
+        // Own queue from the front, then steal from the back of the others
+        for (size_t i = 0; i < queues.size(); ++i) {
+            WorkerQueues& source = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(source.mutex);
+            std::deque<Task>& tasks = source.tasks[p];
+            if (tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            } else {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                classes[p].stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+            classes[p].queued.fetch_sub(1);
+            queuedTotal.fetch_sub(1);
+            priority = p;
+            return true;
+        }
+        release(p);
+    }
+    return false;
+}
+
+void OperationScheduler::runTask(size_t priority, Task& task) {
+    ClassState& state = classes[priority];
+    Clock::time_point start = Clock::now();
+    uint64_t wait = std::chrono::duration_cast<std::chrono::nanoseconds>(start - task.queued).count();
+    try {
+        task.run();
+    } catch (...) {
+        // The worker and the class's budget must survive a throwing task
+        state.failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t service = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    release(priority);
+
+    // Moving average with weight 1/8; concurrent updates may drop a sample
+    uint64_t average = state.serviceNanos.load(std::memory_order_relaxed);
+    state.serviceNanos.store(average == 0 ? service : average - average / 8 + service / 8, std::memory_order_relaxed);
+    state.waitNanos.fetch_add(wait, std::memory_order_relaxed);
+    uint64_t longest = state.maxWaitNanos.load(std::memory_order_relaxed);
+    while (wait > longest && !state.maxWaitNanos.compare_exchange_weak(longest, wait, std::memory_order_relaxed)) {
+    }
+    state.completed.fetch_add(1, std::memory_order_relaxed);
+
+    // A freed budget may unblock work other workers passed over, and idle
+    // workers must see the queue drain during shutdown
+    if (queuedTotal.load() > 0 || stopping.load()) {
+        signalWork();
+    }
+}
+
+void OperationScheduler::workerLoop(size_t self) {
+    while (true) {
+        uint64_t seen = generation.load();
+        Task task;
+        size_t priority;
+        if (takeTask(self, task, priority)) {
+            runTask(priority, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        if (stopping && queuedTotal.load() == 0) {
+            return;
+        }
+        workAvailable.wait(lock, [this, seen]() {
+            return (stopping && queuedTotal.load() == 0) || generation.load() != seen;
+        });
+    }
+}
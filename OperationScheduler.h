@@ -0,0 +1,131 @@
+#ifndef OPERATION_SCHEDULER_H
+#define OPERATION_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Priority class of a scheduled operation, most urgent first
+enum class Priority {
+    Interactive,    // Balance reads and session checks
+    Transaction,    // Deposits, withdrawals, transfers, new accounts
+    Authentication, // Registration and login (password hashing)
+    Batch           // Bulk saves and end-of-day jobs
+};
+
+// Limits for one priority class
+struct PriorityBudget {
+    int workers = 1;                    // Most workers running this class at once
+    double latencyTargetMicros = 0;     // Shed work expected to wait longer
+    size_t maxQueued = 0;               // Shed work beyond this queue depth
+};
+
+// Counters for one priority class
+struct SchedulerStats {
+    uint64_t submitted = 0;
+    uint64_t shed = 0;                  // Rejected by admission control
+    uint64_t completed = 0;
+    uint64_t failed = 0;                // Completed by throwing
+    uint64_t stolen = 0;                // Run by a worker other than the one queued on
+    double averageWaitMicros = 0;
+    double maxWaitMicros = 0;
+};
+
+// Runs operations on a fixed worker pool in priority order.
+//
+// Each worker owns a queue per class. Submissions are spread over the
+// workers; a worker takes from its own queues first and steals from the
+// others when idle. A class never occupies more workers than its budget, and
+// part of the pool is held back for Interactive work, so registrations and
+// batch jobs cannot crowd out balance reads. Work whose expected queueing
+// delay exceeds its class's latency target is shed at submission.
+class OperationScheduler {
+private:
+    static const size_t CLASS_COUNT = 4;
+    using Clock = std::chrono::steady_clock;
+
+    struct Task {
+        std::function<void()> run;
+        Clock::time_point queued;
+    };
+
+    struct alignas(64) WorkerQueues {
+        std::mutex mutex;
+        std::deque<Task> tasks[CLASS_COUNT];
+    };
+
+    struct alignas(64) ClassState {
+        std::atomic<int> workerBudget{1};
+        std::atomic<uint64_t> latencyTargetNanos{0};
+        std::atomic<size_t> maxQueued{0};
+        std::atomic<int> running{0};
+        std::atomic<size_t> queued{0};
+        std::atomic<uint64_t> serviceNanos{0};  // Moving average of run time
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> shed{0};
+        std::atomic<uint64_t> completed{0};
+        std::atomic<uint64_t> failed{0};
+        std::atomic<uint64_t> stolen{0};
+        std::atomic<uint64_t> waitNanos{0};
+        std::atomic<uint64_t> maxWaitNanos{0};
+    };
+
+    std::vector<std::unique_ptr<WorkerQueues>> queues;
+    ClassState classes[CLASS_COUNT];
+    int backgroundBudget;                   // Workers not reserved for Interactive
+    std::atomic<int> backgroundRunning{0};
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<size_t> queuedTotal{0};
+
+    // Bumped under idleMutex whenever work is queued or a budget frees up
+    std::mutex idleMutex;
+    std::condition_variable workAvailable;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<bool> stopping;
+
+    std::vector<std::thread> workers;
+
+    void workerLoop(size_t self);
+    bool acquire(size_t priority);
+    void release(size_t priority);
+    bool takeTask(size_t self, Task& task, size_t& priority);
+    void runTask(size_t priority, Task& task);
+    void signalWork();
+
+public:
+    // workerCount 0 uses one worker per hardware thread
+    explicit OperationScheduler(size_t workerCount = 0);
+    ~OperationScheduler();
+
+    OperationScheduler(const OperationScheduler&) = delete;
+    OperationScheduler& operator=(const OperationScheduler&) = delete;
+
+    // Budgets may be changed while running; workers is clamped to the pool
+    void setBudget(Priority priority, const PriorityBudget& budget);
+    PriorityBudget getBudget(Priority priority) const;
+
+    // Queue a task; false if admission control shed it. An exception thrown
+    // by the task is counted as failed and otherwise dropped.
+    bool submit(Priority priority, std::function<void()> task);
+
+    // Run a task on the pool and wait for it; false if it was shed. An
+    // exception thrown by the task is rethrown here.
+    bool call(Priority priority, const std::function<void()>& task);
+
+    // Refuse new work, finish what is queued and join the workers
+    void shutdown();
+
+    SchedulerStats getStats(Priority priority) const;
+    size_t getWorkerCount() const;
+};
+
+const char* priorityName(Priority priority);
+
+#endif
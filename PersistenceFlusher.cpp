@@ -0,0 +1,629 @@
+#include "PersistenceFlusher.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+std::string tempName(const std::string& filename) {
+    return filename + ".tmp";
+}
+
+// Write the remainder of a buffer starting at offset, then fsync
+bool writeFully(int fd, const std::string& contents, size_t offset) {
+    while (offset < contents.size()) {
+        ssize_t written = pwrite(fd, contents.data() + offset, contents.size() - offset, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    return fsync(fd) == 0;
+}
+
+// Write a file to a temporary name, fsync it and rename it into place
+bool writeFileDurably(const std::string& filename, const std::string& contents) {
+    std::string temp = tempName(filename);
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = writeFully(fd, contents, 0);
+    close(fd);
+    return ok && std::rename(temp.c_str(), filename.c_str()) == 0;
+}
+
+// Append to a file and fsync it; a failed append is truncated away
+bool appendDurably(const std::string& filename, const std::string& records) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    bool ok = size >= 0;
+    for (size_t offset = 0; ok && offset < records.size(); ) {
+        ssize_t written = write(fd, records.data() + offset, records.size() - offset);
+        if (written < 0 && errno != EINTR) {
+            ok = false;
+        } else if (written > 0) {
+            offset += static_cast<size_t>(written);
+        }
+    }
+    ok = ok && fsync(fd) == 0;
+    if (!ok && size >= 0) {
+        int error = errno;
+        if (ftruncate(fd, size) != 0) {
+            std::cerr << "Failed to cut off partial append to " << filename << std::endl;
+        }
+        errno = error;
+    }
+    close(fd);
+    return ok;
+}
+
+void reportFailure(const std::string& filename) {
+    std::cerr << "Failed to persist " << filename << ": " << std::strerror(errno) << std::endl;
+}
+
+} // namespace
+
+std::string directoryOf(const std::string& filename) {
+    size_t slash = filename.rfind('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : filename.substr(0, slash);
+}
+
+bool syncDirectory(const std::string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+#ifdef __linux__
+
+// Minimal io_uring wrapper over the raw system calls: batches of linked
+// write + fsync pairs
+class IoUring {
+private:
+    int fd;
+    unsigned entries;
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+    bool broken;
+
+    IoUring() : fd(-1), entries(0), sqRing(MAP_FAILED), sqRingSize(0), cqRing(MAP_FAILED),
+                cqRingSize(0), sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), sqesSize(0), broken(false) {}
+
+    io_uring_sqe* nextSqe(unsigned& tail) {
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        ++tail;
+        return sqe;
+    }
+
+public:
+    ~IoUring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    static std::unique_ptr<IoUring> create(unsigned requestedEntries) {
+        std::unique_ptr<IoUring> ring(new IoUring());
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, requestedEntries, &params));
+        if (ring->fd < 0) {
+            return nullptr;
+        }
+        ring->entries = params.sq_entries;
+
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+        }
+        ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_SQ_RING);
+        if (ring->sqRing == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->cqRing = singleMmap ? ring->sqRing
+                                  : mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(ring->sqRing);
+        char* cq = static_cast<char*>(ring->cqRing);
+        ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return ring;
+    }
+
+    // Set once completions could not be collected after a failed submit;
+    // the ring must not be used again
+    bool isBroken() const {
+        return broken;
+    }
+
+    // Write each buffer to its descriptor at offset 0 and fsync it. Files
+    // whose write came back short or failed are finished synchronously.
+    std::vector<bool> writeAndSync(const std::vector<int>& fds, const std::vector<const std::string*>& data) {
+        std::vector<bool> ok(fds.size(), true);
+        std::vector<ssize_t> writeResult(fds.size(), 0);
+        std::vector<iovec> iov(fds.size());
+        const size_t perSubmit = entries / 2;
+
+        for (size_t start = 0; start < fds.size(); start += perSubmit) {
+            size_t end = std::min(fds.size(), start + perSubmit);
+            unsigned tail = *sqTail;
+            for (size_t i = start; i < end; ++i) {
+                iov[i].iov_base = const_cast<char*>(data[i]->data());
+                iov[i].iov_len = data[i]->size();
+
+                io_uring_sqe* write = nextSqe(tail);
+                write->opcode = IORING_OP_WRITEV;
+                write->fd = fds[i];
+                write->addr = reinterpret_cast<uint64_t>(&iov[i]);
+                write->len = 1;
+                write->off = 0;
+                write->flags = IOSQE_IO_LINK;
+                write->user_data = i * 2;
+
+                io_uring_sqe* sync = nextSqe(tail);
+                sync->opcode = IORING_OP_FSYNC;
+                sync->fd = fds[i];
+                sync->user_data = i * 2 + 1;
+            }
+            unsigned startTail = *sqTail;
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+            auto reap = [&]() {
+                unsigned reaped = 0;
+                unsigned head = *cqHead;
+                while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                    const io_uring_cqe& cqe = cqes[head & *cqMask];
+                    size_t file = static_cast<size_t>(cqe.user_data / 2);
+                    if (cqe.user_data % 2 == 0) {
+                        writeResult[file] = cqe.res;
+                        if (cqe.res < 0 || static_cast<size_t>(cqe.res) != data[file]->size()) {
+                            ok[file] = false;
+                        }
+                    } else if (cqe.res < 0) {
+                        ok[file] = false;
+                    }
+                    ++head;
+                    ++reaped;
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                return reaped;
+            };
+
+            unsigned toSubmit = static_cast<unsigned>((end - start) * 2);
+            unsigned completed = 0;
+            bool failed = false;
+            while (completed < toSubmit) {
+                unsigned unsubmitted = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+                int entered = static_cast<int>(syscall(__NR_io_uring_enter, fd, unsubmitted, 1,
+                                                       IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (entered < 0 && errno != EINTR) {
+                    failed = true;
+                    break;
+                }
+                completed += reap();
+            }
+            if (failed) {
+                // Withdraw the entries the kernel never took, then collect the
+                // completions of those it did: they point at this batch's
+                // buffers and must not surface in a later batch
+                unsigned submitted = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) - startTail;
+                __atomic_store_n(sqTail, startTail + submitted, __ATOMIC_RELEASE);
+                if (!drain(submitted - completed, reap)) {
+                    broken = true;
+                }
+                for (size_t i = start; i < fds.size(); ++i) {
+                    writeResult[i] = 0;
+                    ok[i] = false;
+                }
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!ok[i]) {
+                size_t offset = writeResult[i] > 0 ? static_cast<size_t>(writeResult[i]) : 0;
+                ok[i] = writeFully(fds[i], *data[i], offset);
+            }
+        }
+        return ok;
+    }
+
+private:
+    // Wait for outstanding completions, polling if the ring refuses to
+    // enter. Gives up after about five seconds.
+    template <typename Reap>
+    bool drain(unsigned outstanding, Reap& reap) {
+        for (int attempt = 0; outstanding > 0; ) {
+            int entered = static_cast<int>(syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (entered < 0 && errno != EINTR) {
+                if (++attempt > 5000) {
+                    return false;
+                }
+                usleep(1000);
+            }
+            outstanding -= std::min(outstanding, reap());
+        }
+        return true;
+    }
+};
+
+#else
+
+class IoUring {
+public:
+    static std::unique_ptr<IoUring> create(unsigned) {
+        return nullptr;
+    }
+
+    bool isBroken() const {
+        return false;
+    }
+
+    std::vector<bool> writeAndSync(const std::vector<int>& fds, const std::vector<const std::string*>& data) {
+        std::vector<bool> ok;
+        for (size_t i = 0; i < fds.size(); ++i) {
+            ok.push_back(writeFully(fds[i], *data[i], 0));
+        }
+        return ok;
+    }
+};
+
+#endif
+
+// PersistenceFlusher implementation
+PersistenceFlusher::PersistenceFlusher(size_t maxPendingBytes, size_t poolThreads)
+    : pendingBytes(0), maxPendingBytes(maxPendingBytes), nextTicket(1), durableTicket(0), flushedTicket(0),
+      bytesWritten(0), stopping(false), poolNext(0), poolRemaining(0) {
+    if (std::getenv("BANKING_DISABLE_IO_URING") == nullptr) {
+        ring = IoUring::create(64);
+    }
+    if (!ring) {
+        startPool(poolThreads);
+    }
+    flusher = std::thread(&PersistenceFlusher::flusherLoop, this);
+}
+
+PersistenceFlusher::~PersistenceFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    flusher.join();
+
+    // The flusher has drained every batch, so the pool is idle
+    poolWork.notify_all();
+    for (auto& worker : pool) {
+        worker.join();
+    }
+}
+
+PersistenceFlusher& PersistenceFlusher::instance() {
+    static PersistenceFlusher flusher;
+    return flusher;
+}
+
+void PersistenceFlusher::startPool(size_t threads) {
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+        pool.emplace_back(&PersistenceFlusher::poolLoop, this);
+    }
+}
+
+bool PersistenceFlusher::submit(const std::string& filename, std::string contents, Durability durability,
+                                uint64_t* ticket) {
+    return enqueue(filename, std::move(contents), false, durability, ticket);
+}
+
+bool PersistenceFlusher::append(const std::string& filename, std::string records, Durability durability,
+                                uint64_t* ticket) {
+    return enqueue(filename, std::move(records), true, durability, ticket);
+}
+
+bool PersistenceFlusher::enqueue(const std::string& filename, std::string data, bool append, Durability durability,
+                                 uint64_t* ticket) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Backpressure: wait for the flusher to pick up queued data. A single
+    // oversized file is still accepted into an empty queue.
+    spaceAvailable.wait(lock, [this]() { return pendingBytes < maxPendingBytes || pending.empty(); });
+
+    uint64_t submitted = nextTicket++;
+    size_t size = data.size();
+    auto it = pending.find(filename);
+    if (it == pending.end()) {
+        pending.emplace(filename, Job{std::move(data), append, {submitted}});
+    } else if (append) {
+        // Queued contents, whole or appended, simply grow
+        it->second.contents += data;
+        it->second.tickets.push_back(submitted);
+    } else {
+        pendingBytes -= it->second.contents.size();
+        it->second.contents = std::move(data);
+        it->second.append = false;
+        it->second.tickets.push_back(submitted);
+    }
+    pendingBytes += size;
+    workAvailable.notify_one();
+    if (ticket) {
+        *ticket = submitted;
+    }
+
+    if (durability == Durability::Wait) {
+        return waitLocked(lock, submitted);
+    }
+    return true;
+}
+
+bool PersistenceFlusher::waitLocked(std::unique_lock<std::mutex>& lock, uint64_t ticket) {
+    batchDone.wait(lock, [this, ticket]() { return durableTicket >= ticket; });
+    return failedTickets.count(ticket) == 0;
+}
+
+bool PersistenceFlusher::waitFor(uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return waitLocked(lock, ticket);
+}
+
+bool PersistenceFlusher::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t ticket = nextTicket - 1;
+    batchDone.wait(lock, [this, ticket]() { return durableTicket >= ticket; });
+    bool ok = failedTickets.upper_bound(flushedTicket) == failedTickets.upper_bound(ticket);
+    flushedTicket = std::max(flushedTicket, ticket);
+    return ok;
+}
+
+bool PersistenceFlusher::pendingContents(const std::string& filename, std::string& contents) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        auto it = pending.find(filename);
+        if (it == pending.end()) {
+            it = inFlight.find(filename);
+            if (it == inFlight.end()) {
+                return false;
+            }
+        }
+        if (!it->second.append) {
+            contents = it->second.contents;
+            return true;
+        }
+        uint64_t ticket = it->second.tickets.back();
+        batchDone.wait(lock, [this, ticket]() { return durableTicket >= ticket; });
+    }
+}
+
+bool PersistenceFlusher::usingIoUring() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ring != nullptr;
+}
+
+uint64_t PersistenceFlusher::getBytesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesWritten;
+}
+
+void PersistenceFlusher::flusherLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workAvailable.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            break;  // Stopping and fully drained
+        }
+
+        // Take everything queued so far as one batch
+        inFlight.swap(pending);
+        pendingBytes = 0;
+        uint64_t batchTicket = nextTicket - 1;
+        spaceAvailable.notify_all();
+
+        // inFlight is only modified by this thread, so it can be read unlocked
+        lock.unlock();
+        std::set<std::string> failed = writeBatch(inFlight);
+        uint64_t batchBytes = 0;
+        for (const auto& entry : inFlight) {
+            batchBytes += entry.second.contents.size();
+        }
+        lock.lock();
+
+        // Remember failed submissions so waiters can be told; only the most
+        // recent ones are kept
+        for (const std::string& name : failed) {
+            const Job& job = inFlight.at(name);
+            failedTickets.insert(job.tickets.begin(), job.tickets.end());
+        }
+        while (failedTickets.size() > MAX_FAILED_TICKETS) {
+            failedTickets.erase(failedTickets.begin());
+        }
+
+        inFlight.clear();
+        bytesWritten += batchBytes;
+        durableTicket = batchTicket;
+        batchDone.notify_all();
+    }
+}
+
+std::set<std::string> PersistenceFlusher::writeBatch(const std::map<std::string, Job>& batch) {
+    std::set<std::string> failed;
+    std::vector<const std::string*> written;
+
+    if (!ring) {
+        std::vector<bool> ok = writeBatchWithPool(batch);
+        size_t i = 0;
+        for (const auto& entry : batch) {
+            if (ok[i++]) {
+                written.push_back(&entry.first);
+            } else {
+                failed.insert(entry.first);
+            }
+        }
+    } else {
+        std::vector<const std::string*> names;
+        std::vector<const std::string*> data;
+        std::vector<int> fds;
+        for (const auto& entry : batch) {
+            // Appends are small; they are written here while the ring
+            // handles the whole files
+            if (entry.second.append) {
+                if (appendDurably(entry.first, entry.second.contents)) {
+                    written.push_back(&entry.first);
+                } else {
+                    reportFailure(entry.first);
+                    failed.insert(entry.first);
+                }
+                continue;
+            }
+            int fd = open(tempName(entry.first).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                reportFailure(entry.first);
+                failed.insert(entry.first);
+                continue;
+            }
+            names.push_back(&entry.first);
+            data.push_back(&entry.second.contents);
+            fds.push_back(fd);
+        }
+
+        std::vector<bool> ok = ring->writeAndSync(fds, data);
+        for (size_t i = 0; i < fds.size(); ++i) {
+            close(fds[i]);
+            if (!ok[i] || std::rename(tempName(*names[i]).c_str(), names[i]->c_str()) != 0) {
+                reportFailure(*names[i]);
+                failed.insert(*names[i]);
+            } else {
+                written.push_back(names[i]);
+            }
+        }
+
+        // A ring whose completions could not be collected may still write
+        // into freed buffers; replace it with the worker pool
+        if (ring->isBroken()) {
+            std::cerr << "io_uring failed, falling back to the worker pool" << std::endl;
+            std::lock_guard<std::mutex> lock(mutex);
+            ring.reset();
+            startPool(4);
+        }
+    }
+
+    // One fsync per directory makes this batch's renames and new files durable
+    std::map<std::string, std::vector<const std::string*>> directories;
+    for (const std::string* name : written) {
+        directories[directoryOf(*name)].push_back(name);
+    }
+    for (const auto& directory : directories) {
+        if (!syncDirectory(directory.first)) {
+            for (const std::string* name : directory.second) {
+                reportFailure(*name);
+                failed.insert(*name);
+            }
+        }
+    }
+    return failed;
+}
+
+std::vector<bool> PersistenceFlusher::writeBatchWithPool(const std::map<std::string, Job>& batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    poolQueue.clear();
+    for (const auto& entry : batch) {
+        poolQueue.emplace_back(&entry.first, &entry.second);
+    }
+    poolResults.assign(poolQueue.size(), false);
+    poolNext = 0;
+    poolRemaining = poolQueue.size();
+    poolWork.notify_all();
+    poolDone.wait(lock, [this]() { return poolRemaining == 0; });
+    poolQueue.clear();
+    return poolResults;
+}
+
+void PersistenceFlusher::poolLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        poolWork.wait(lock, [this]() { return poolNext < poolQueue.size() || (stopping && inFlight.empty() && pending.empty()); });
+        if (poolNext >= poolQueue.size()) {
+            break;
+        }
+        size_t index = poolNext++;
+        auto job = poolQueue[index];
+        lock.unlock();
+        bool ok = job.second->append ? appendDurably(*job.first, job.second->contents)
+                                     : writeFileDurably(*job.first, job.second->contents);
+        if (!ok) {
+            reportFailure(*job.first);
+        }
+        lock.lock();
+        poolResults[index] = ok;
+        if (--poolRemaining == 0) {
+            poolDone.notify_one();
+        }
+    }
+}
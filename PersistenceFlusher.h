@@ -0,0 +1,126 @@
+#ifndef PERSISTENCE_FLUSHER_H
+#define PERSISTENCE_FLUSHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <cstdint>
+
+// How long a persisting call waits for its data
+enum class Durability {
+    Async,  // Return once the write is queued
+    Wait    // Return once the write has been fsynced
+};
+
+class IoUring;
+
+// Background flusher that writes files off the caller's thread, either whole
+// or by appending records. Submissions for the same file are coalesced (the
+// latest contents win, and appends are concatenated onto what is queued), the
+// flusher thread writes each batch through io_uring when the kernel supports
+// it and through a worker pool otherwise, fsyncs, then atomically renames the
+// new file into place. The directories touched by a batch are fsynced once
+// the renames are done, so the renames survive a crash too. Appends go
+// straight to the end of the file and are fsynced; a failed append is cut
+// off again so the file never holds a partial record.
+class PersistenceFlusher {
+private:
+    static const size_t MAX_FAILED_TICKETS = 4096;
+
+    struct Job {
+        std::string contents;
+        bool append;                        // contents go after the existing file
+        std::vector<uint64_t> tickets;      // Every submission coalesced into this one
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable spaceAvailable;
+    std::condition_variable batchDone;
+
+    std::map<std::string, Job> pending;     // Queued, not yet picked up
+    std::map<std::string, Job> inFlight;    // Being written by the current batch
+    size_t pendingBytes;
+    size_t maxPendingBytes;
+    uint64_t nextTicket;
+    uint64_t durableTicket;
+    uint64_t flushedTicket;                 // Target of the previous flush()
+    std::set<uint64_t> failedTickets;       // Recent submissions that were not persisted
+    uint64_t bytesWritten;
+    bool stopping;
+
+    std::unique_ptr<IoUring> ring;
+
+    // Fallback worker pool, used when io_uring is unavailable
+    std::vector<std::thread> pool;
+    std::vector<std::pair<const std::string*, const Job*>> poolQueue;
+    std::vector<bool> poolResults;
+    size_t poolNext;
+    size_t poolRemaining;
+    std::condition_variable poolWork;
+    std::condition_variable poolDone;
+
+    std::thread flusher;
+
+    void flusherLoop();
+    void poolLoop();
+    void startPool(size_t threads);
+    bool waitLocked(std::unique_lock<std::mutex>& lock, uint64_t ticket);
+    bool enqueue(const std::string& filename, std::string data, bool append, Durability durability,
+                 uint64_t* ticket);
+
+    // Write a batch; returns the names of the files that were not persisted
+    std::set<std::string> writeBatch(const std::map<std::string, Job>& batch);
+    std::vector<bool> writeBatchWithPool(const std::map<std::string, Job>& batch);
+
+public:
+    explicit PersistenceFlusher(size_t maxPendingBytes = 64 * 1024 * 1024, size_t poolThreads = 4);
+    ~PersistenceFlusher();
+
+    PersistenceFlusher(const PersistenceFlusher&) = delete;
+    PersistenceFlusher& operator=(const PersistenceFlusher&) = delete;
+
+    // Process-wide flusher shared by Storage and Bank
+    static PersistenceFlusher& instance();
+
+    // Queue the full contents of a file. Blocks while the queue is over its
+    // byte budget. With Durability::Wait, also blocks until the write is done
+    // and returns false if it failed. The ticket for waitFor() is stored in
+    // ticket when given.
+    bool submit(const std::string& filename, std::string contents, Durability durability = Durability::Async,
+                uint64_t* ticket = nullptr);
+
+    // Queue records to add to the end of a file; otherwise like submit()
+    bool append(const std::string& filename, std::string records, Durability durability = Durability::Async,
+                uint64_t* ticket = nullptr);
+
+    // Block until the submission with this ticket is done; false if it was
+    // not persisted
+    bool waitFor(uint64_t ticket);
+
+    // Block until everything submitted so far is durable; false if anything
+    // submitted since the previous flush failed
+    bool flush();
+
+    // Latest queued or in-flight contents of a file, so readers see their
+    // own writes before they reach disk. Queued appends are waited for
+    // instead, since only the file holds what they append to; false then
+    // means the file is current.
+    bool pendingContents(const std::string& filename, std::string& contents);
+
+    bool usingIoUring() const;
+    uint64_t getBytesWritten() const;
+};
+
+// Directory holding a file, "." for a bare name
+std::string directoryOf(const std::string& filename);
+
+// fsync a directory, so renames into it survive a crash
+bool syncDirectory(const std::string& directory);
+
+#endif
@@ -1,8 +1,9 @@
 #include "Storage.h"
-#include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <iostream>
+#include <utility>
+#include <thread>
 
 // Utility function to split strings
 std::vector<std::string> split(const std::string& s, char delimiter) {
@@ -15,21 +16,40 @@ std::vector<std::string> split(const std::string& s, char delimiter) {
     return tokens;
 }
 
+std::string_view nextField(std::string_view& rest, char delimiter) {
+    size_t pos = rest.find(delimiter);
+    std::string_view field = rest.substr(0, pos);
+    rest = pos == std::string_view::npos ? std::string_view() : rest.substr(pos + 1);
+    return field;
+}
+
+// Split a record into exactly count fields; false if it has fewer
+template <size_t N>
+static bool splitFields(std::string_view data, std::string_view (&fields)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        if (data.empty() && i > 0) {
+            return false;
+        }
+        fields[i] = nextField(data, ',');
+    }
+    return true;
+}
+
 // User class implementation
 User::User() : id(0), failedAttempts(0), locked(false), lockTime(0) {}
 
-User::User(int userId, const std::string& user, const std::string& hash) 
-    : id(userId), username(user), passwordHash(hash), failedAttempts(0), locked(false), lockTime(0) {}
+User::User(int userId, std::string user, std::string hash) 
+    : id(userId), username(std::move(user)), passwordHash(std::move(hash)), failedAttempts(0), locked(false), lockTime(0) {}
 
 int User::getId() const { 
     return id; 
 }
 
-std::string User::getUsername() const { 
+const std::string& User::getUsername() const { 
     return username; 
 }
 
-std::string User::getPasswordHash() const { 
+const std::string& User::getPasswordHash() const { 
     return passwordHash; 
 }
 
@@ -71,16 +91,16 @@ std::string User::serialize() const {
     return ss.str();
 }
 
-User User::deserialize(const std::string& data) {
+User User::deserialize(std::string_view data) {
     User user;
-    std::vector<std::string> parts = split(data, ',');
-    if (parts.size() >= 6) {
-        user.id = std::stoi(parts[0]);
+    std::string_view parts[6];
+    if (splitFields(data, parts)) {
+        user.id = parseNumber<int>(parts[0]);
         user.username = parts[1];
         user.passwordHash = parts[2];
-        user.failedAttempts = std::stoi(parts[3]);
+        user.failedAttempts = parseNumber<int>(parts[3]);
         user.locked = (parts[4] == "1");
-        user.lockTime = std::stol(parts[5]);
+        user.lockTime = parseNumber<time_t>(parts[5]);
     }
     return user;
 }
@@ -88,13 +108,13 @@ User User::deserialize(const std::string& data) {
 // Session class implementation
 Session::Session() : userId(0), creationTime(0), expiryTime(0) {}
 
-Session::Session(int id, const std::string& sessionToken, int durationSeconds) 
-    : token(sessionToken), userId(id) {
+Session::Session(int id, std::string sessionToken, int durationSeconds) 
+    : token(std::move(sessionToken)), userId(id) {
     creationTime = time(nullptr);
     expiryTime = creationTime + durationSeconds;
 }
 
-std::string Session::getToken() const { 
+const std::string& Session::getToken() const { 
     return token; 
 }
 
@@ -120,166 +140,548 @@ std::string Session::serialize() const {
     return ss.str();
 }
 
-Session Session::deserialize(const std::string& data) {
+Session Session::deserialize(std::string_view data) {
     Session session;
-    std::vector<std::string> parts = split(data, ',');
-    if (parts.size() >= 4) {
+    std::string_view parts[4];
+    if (splitFields(data, parts)) {
         session.token = parts[0];
-        session.userId = std::stoi(parts[1]);
-        session.creationTime = std::stol(parts[2]);
-        session.expiryTime = std::stol(parts[3]);
+        session.userId = parseNumber<int>(parts[1]);
+        session.creationTime = parseNumber<time_t>(parts[2]);
+        session.expiryTime = parseNumber<time_t>(parts[3]);
     }
     return session;
 }
 
 // Storage class implementation
-std::vector<std::string> Storage::readAllLines(const std::string& filename) {
-    std::vector<std::string> lines;
-    std::ifstream file(filename);
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            lines.push_back(line);
+//
+// Users and sessions live in memory as file contents plus an offset index,
+// so lookups deserialize only the matching line. Every change rewrites the
+// contents, reindexes them and hands them to the backend.
+template <typename Backend>
+void BasicStorage<Backend>::FileIndex::rebuild() {
+    byKey.clear();
+    byId.clear();
+    maxId = 0;
+    lines = 0;
+    indexFrom(0);
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::FileIndex::indexFrom(size_t offset) {
+    while (offset < contents.size()) {
+        std::string_view line = lineAt(offset);
+        if (!line.empty()) {
+            std::string_view fields = line;
+            std::string_view first = nextField(fields, ',');
+            std::string_view key = first;
+            for (size_t i = 0; i < keyField; ++i) {
+                key = nextField(fields, ',');
+            }
+            byKey[key] = offset;
+            if (indexIds) {
+                int id = parseNumber<int>(first);
+                byId[id] = offset;
+                maxId = std::max(maxId, id);
+            }
+            lines++;
         }
-        file.close();
+        offset += line.size() + 1;
     }
-    return lines;
 }
 
-void Storage::writeAllLines(const std::string& filename, const std::vector<std::string>& lines) {
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        for (const auto& line : lines) {
-            file << line << std::endl;
-        }
-        file.close();
+template <typename Backend>
+void BasicStorage<Backend>::FileIndex::append(std::string_view records) {
+    // Keys point into contents, so only a reallocation forces a full reindex;
+    // growing geometrically keeps that rare
+    size_t offset = contents.size();
+    if (offset + records.size() > contents.capacity()) {
+        contents.reserve(2 * (offset + records.size()));
+        contents += records;
+        rebuild();
+    } else {
+        contents += records;
+        indexFrom(offset);
     }
 }
 
-std::vector<User> Storage::getAllUsers() {
-    std::vector<User> users;
-    for (const auto& line : readAllLines(USERS_FILE)) {
-        if (!line.empty()) {
-            users.push_back(User::deserialize(line));
-        }
+template <typename Backend>
+std::string_view BasicStorage<Backend>::FileIndex::lineAt(size_t offset) const {
+    std::string_view rest = std::string_view(contents).substr(offset);
+    return nextField(rest, '\n');
+}
+
+template <typename Backend>
+typename BasicStorage<Backend>::FileIndex& BasicStorage<Backend>::usersIndex() {
+    static FileIndex index(1, true);
+    return index;
+}
+
+template <typename Backend>
+typename BasicStorage<Backend>::FileIndex& BasicStorage<Backend>::sessionsIndex() {
+    static FileIndex index(0, false);
+    return index;
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::loadIndex(FileIndex& index, const std::string& filename) {
+    // A cleared backend invalidates everything cached from it
+    uint64_t generation = Backend::getGeneration();
+    if (!index.loaded || index.generation != generation) {
+        index.contents = backend.read(filename);
+        index.rebuild();
+        index.loaded = true;
+        index.generation = generation;
     }
+}
+
+template <typename Backend>
+bool BasicStorage<Backend>::replaceContents(FileIndex& index, const std::string& filename, std::string contents) {
+    index.contents = std::move(contents);
+    index.rebuild();
+    return writeContents(filename, index.contents);
+}
+
+template <typename Backend>
+std::string BasicStorage<Backend>::readContents(FileIndex& index, const std::string& filename) {
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, filename);
+    return index.contents;
+}
+
+template <typename Backend>
+bool BasicStorage<Backend>::writeContents(const std::string& filename, std::string contents) {
+    return backend.write(filename, std::move(contents), durability);
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::preload() {
+    std::thread sessions([this]() {
+        FileIndex& index = sessionsIndex();
+        std::lock_guard<std::mutex> lock(index.mutex);
+        loadIndex(index, SESSIONS_FILE);
+    });
+    {
+        FileIndex& index = usersIndex();
+        std::lock_guard<std::mutex> lock(index.mutex);
+        loadIndex(index, USERS_FILE);
+    }
+    {
+        UsernameFilter& shared = usernameFilter();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        loadUsernameFilter(shared);
+    }
+    sessions.join();
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::setDurability(Durability mode) {
+    durability = mode;
+}
+
+template <typename Backend>
+uint64_t BasicStorage<Backend>::getBytesWritten() {
+    return Backend::getBytesWritten();
+}
+
+template <typename Backend>
+std::vector<User> BasicStorage<Backend>::getAllUsers() {
+    std::vector<User> users;
+    forEachUser([&users](User&& user) { users.push_back(std::move(user)); });
     return users;
 }
 
-User Storage::getUserById(int id) {
-    for (const auto& user : getAllUsers()) {
-        if (user.getId() == id) {
-            return user;
-        }
+template <typename Backend>
+User BasicStorage<Backend>::getUserById(int id) {
+    FileIndex& index = usersIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, USERS_FILE);
+    auto it = index.byId.find(id);
+    if (it == index.byId.end()) {
+        return User(); // Return empty user if not found
     }
-    return User(); // Return empty user if not found
+    return User::deserialize(index.lineAt(it->second));
 }
 
-User Storage::getUserByUsername(const std::string& username) {
-    for (const auto& user : getAllUsers()) {
-        if (user.getUsername() == username) {
-            return user;
-        }
+template <typename Backend>
+User BasicStorage<Backend>::getUserByUsername(std::string_view username) {
+    FileIndex& index = usersIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, USERS_FILE);
+    auto it = index.byKey.find(username);
+    if (it == index.byKey.end()) {
+        return User(); // Return empty user if not found
     }
-    return User(); // Return empty user if not found
+    return User::deserialize(index.lineAt(it->second));
 }
 
-bool Storage::saveUser(const User& user) {
-    std::vector<User> users = getAllUsers();
-    bool updated = false;
+template <typename Backend>
+bool BasicStorage<Backend>::saveUser(const User& user) {
+    UsernameFilter& shared = usernameFilter();
+    std::lock_guard<std::mutex> filterLock(shared.mutex);
+    loadUsernameFilter(shared);
     
-    for (auto& existingUser : users) {
-        if (existingUser.getId() == user.getId()) {
-            existingUser = user;
-            updated = true;
-            break;
-        }
+    FileIndex& index = usersIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, USERS_FILE);
+    
+    // Splice the record into place, or append it
+    std::string updated;
+    updated.reserve(index.contents.size() + 128);
+    auto it = index.byId.find(user.getId());
+    bool replaced = it != index.byId.end();
+    if (replaced) {
+        size_t length = index.lineAt(it->second).size();
+        updated.append(index.contents, 0, it->second);
+        updated += user.serialize();
+        updated.append(index.contents, it->second + length, std::string::npos);
+    } else {
+        updated = index.contents;
+        updated += user.serialize();
+        updated += '\n';
     }
     
-    if (!updated) {
-        users.push_back(user);
+    // An appended id at or past the shared counter must not be handed out
+    // again. An unset counter starts past it anyway once read.
+    RegistrationQueue& queue = registrationQueue();
+    if (!replaced && queue.idGeneration.load() == index.generation) {
+        int next = queue.nextId.load();
+        while (next != 0 && next <= user.getId() && !queue.nextId.compare_exchange_weak(next, user.getId() + 1)) {
+        }
     }
     
-    std::vector<std::string> lines;
-    for (const auto& u : users) {
-        lines.push_back(u.serialize());
+    // New usernames go into the filter, which is persisted when rebuilt
+    // or saved at shutdown
+    if (!replaced) {
+        shared.filter.add(user.getUsername());
+        shared.dirty = true;
+        if (shared.filter.isOverloaded()) {
+            rebuildUsernameFilter(shared, updated);
+        }
     }
     
-    writeAllLines(USERS_FILE, lines);
-    return true;
+    return replaceContents(index, USERS_FILE, std::move(updated));
 }
 
-int Storage::getNextUserId() {
-    int maxId = 0;
-    for (const auto& user : getAllUsers()) {
-        maxId = std::max(maxId, user.getId());
-    }
-    return maxId + 1;
+template <typename Backend>
+int BasicStorage<Backend>::getNextUserId() {
+    return reserveUserIds(1);
 }
 
-std::vector<Session> Storage::getAllSessions() {
-    std::vector<Session> sessions;
-    for (const auto& line : readAllLines(SESSIONS_FILE)) {
-        if (!line.empty()) {
-            sessions.push_back(Session::deserialize(line));
+template <typename Backend>
+typename BasicStorage<Backend>::RegistrationQueue& BasicStorage<Backend>::registrationQueue() {
+    static RegistrationQueue queue;
+    return queue;
+}
+
+template <typename Backend>
+int BasicStorage<Backend>::reserveUserIds(int count) {
+    // The counter starts past the highest stored id; a counter from before
+    // the backend was cleared is read again
+    RegistrationQueue& queue = registrationQueue();
+    uint64_t generation = Backend::getGeneration();
+    if (queue.nextId.load() == 0 || queue.idGeneration.load() != generation) {
+        FileIndex& index = usersIndex();
+        std::lock_guard<std::mutex> lock(index.mutex);
+        loadIndex(index, USERS_FILE);
+        if (queue.nextId.load() == 0 || queue.idGeneration.load() != index.generation) {
+            queue.nextId.store(index.maxId + 1);
+            queue.idGeneration.store(index.generation);
         }
     }
-    return sessions;
+    return queue.nextId.fetch_add(count);
 }
 
-Session Storage::getSessionByToken(const std::string& token) {
-    for (const auto& session : getAllSessions()) {
-        if (session.getToken() == token) {
-            return session;
-        }
+template <typename Backend>
+int BasicStorage<Backend>::allocateUserId() {
+    // Ids come from a shared counter in per-thread blocks, so concurrent
+    // registrations rarely touch it, even through one storage. Unused ids in
+    // a block are skipped, and so is a block from before the backend was
+    // cleared.
+    static thread_local IdBlock block;
+    uint64_t generation = Backend::getGeneration();
+    if (block.next == block.end || block.generation != generation) {
+        block.next = reserveUserIds(USER_ID_BLOCK);
+        block.end = block.next + USER_ID_BLOCK;
+        block.generation = generation;
     }
-    return Session(); // Return empty session if not found
+    return block.next++;
 }
 
-bool Storage::saveSession(const Session& session) {
-    std::vector<Session> sessions = getAllSessions();
-    bool updated = false;
+template <typename Backend>
+int BasicStorage<Backend>::createUser(const std::string& username, std::string passwordHash) {
+    RegistrationQueue& queue = registrationQueue();
     
-    for (auto& existingSession : sessions) {
-        if (existingSession.getToken() == session.getToken()) {
-            existingSession = session;
-            updated = true;
-            break;
+    // Claim the name first, then check it against the stored users; a name
+    // stays claimed until it is in the index
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.claimed.insert(username).second) {
+            return 0;
         }
     }
+    if (usernameExists(username)) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.claimed.erase(username);
+        return 0;
+    }
     
-    if (!updated) {
-        sessions.push_back(session);
+    int id = allocateUserId();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.pending.emplace_back(id, username, std::move(passwordHash));
+    if (durability == Durability::Wait) {
+        queue.durability = Durability::Wait;
     }
+    uint64_t batch = queue.openBatch;
     
-    // Clean up expired sessions
-    std::vector<Session> validSessions;
-    time_t now = time(nullptr);
-    for (const auto& s : sessions) {
-        if (s.getExpiryTime() > now) {
-            validSessions.push_back(s);
+    // Whoever finds no commit running writes everything queued so far, as
+    // durably as anyone in the batch asked; the rest wait for the batch
+    // holding their user
+    while (queue.committedBatch < batch) {
+        if (queue.committing) {
+            queue.committed.wait(lock);
+            continue;
         }
+        queue.committing = true;
+        std::vector<User> users;
+        users.swap(queue.pending);
+        Durability mode = queue.durability;
+        queue.durability = Durability::Async;
+        
+        // Finishes the batch however the commit ends, so a throwing commit
+        // cannot leave the queue marked busy or its waiters asleep
+        struct BatchGuard {
+            RegistrationQueue& queue;
+            std::unique_lock<std::mutex>& lock;
+            const std::vector<User>& users;
+            uint64_t batch;
+            bool persisted;
+            
+            ~BatchGuard() {
+                if (!lock.owns_lock()) {
+                    lock.lock();
+                }
+                for (const User& user : users) {
+                    queue.claimed.erase(user.getUsername());
+                }
+                if (!persisted) {
+                    queue.failedBatches.insert(batch);
+                }
+                queue.committedBatch = batch;
+                queue.committing = false;
+                queue.committed.notify_all();
+            }
+        } guard{queue, lock, users, queue.openBatch++, false};
+        
+        lock.unlock();
+        guard.persisted = commitUsers(users, mode);
     }
+    return queue.failedBatches.count(batch) == 0 ? id : 0;
+}
+
+template <typename Backend>
+bool BasicStorage<Backend>::commitUsers(const std::vector<User>& users, Durability mode) {
+    UsernameFilter& shared = usernameFilter();
+    std::lock_guard<std::mutex> filterLock(shared.mutex);
+    loadUsernameFilter(shared);
+    
+    FileIndex& index = usersIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, USERS_FILE);
     
-    std::vector<std::string> lines;
-    for (const auto& s : validSessions) {
-        lines.push_back(s.serialize());
+    // One filter update and one append to the users file for the whole batch
+    std::string records;
+    for (const User& user : users) {
+        records += user.serialize();
+        records += '\n';
+        shared.filter.add(user.getUsername());
+    }
+    size_t committed = index.contents.size();
+    index.append(records);
+    shared.dirty = true;
+    if (shared.filter.isOverloaded()) {
+        rebuildUsernameFilter(shared, index.contents);
+    }
+    if (backend.append(USERS_FILE, std::move(records), mode)) {
+        return true;
     }
     
-    writeAllLines(SESSIONS_FILE, lines);
-    return true;
+    // Users that were not persisted must not be found either, or a later
+    // write would persist them after their registration was refused
+    index.contents.resize(committed);
+    index.rebuild();
+    rebuildUsernameFilter(shared, index.contents);
+    return false;
 }
 
-bool Storage::deleteSession(const std::string& token) {
-    std::vector<Session> sessions = getAllSessions();
-    sessions.erase(std::remove_if(sessions.begin(), sessions.end(), 
-        [&token](const Session& s) { return s.getToken() == token; }), sessions.end());
+template <typename Backend>
+bool BasicStorage<Backend>::usernameExists(std::string_view username) {
+    UsernameFilter& shared = usernameFilter();
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        loadUsernameFilter(shared);
+        if (!shared.filter.mightContain(username)) {
+            return false;
+        }
+    }
     
-    std::vector<std::string> lines;
-    for (const auto& s : sessions) {
-        lines.push_back(s.serialize());
+    if (getUserByUsername(username).getId() != 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    shared.filter.recordFalsePositive();
+    return false;
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::rebuildUsernameFilter() {
+    UsernameFilter& shared = usernameFilter();
+    std::lock_guard<std::mutex> filterLock(shared.mutex);
+    FileIndex& index = usersIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, USERS_FILE);
+    rebuildUsernameFilter(shared, index.contents);
+    shared.loaded = true;
+    shared.generation = index.generation;
+}
+
+template <typename Backend>
+BloomFilterStats BasicStorage<Backend>::getUsernameFilterStats() {
+    UsernameFilter& shared = usernameFilter();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    return shared.filter.getStats();
+}
+
+template <typename Backend>
+typename BasicStorage<Backend>::UsernameFilter& BasicStorage<Backend>::usernameFilter() {
+    static UsernameFilter shared;
+    return shared;
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::loadUsernameFilter(UsernameFilter& shared) {
+    if (shared.loaded && shared.generation == Backend::getGeneration()) {
+        return;
     }
     
-    writeAllLines(SESSIONS_FILE, lines);
-    return true;
-}
\ No newline at end of file
+    // The persisted filter is trusted only if it covers every stored user;
+    // otherwise (first run, users added without a clean shutdown) it is
+    // rebuilt
+    FileIndex& index = usersIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, USERS_FILE);
+    
+    BloomFilter persisted;
+    if (BloomFilter::deserialize(backend.read(USERS_FILTER_FILE), persisted) &&
+        persisted.getItemCount() == index.lines && !persisted.isOverloaded()) {
+        shared.filter = std::move(persisted);
+        shared.dirty = false;
+    } else {
+        rebuildUsernameFilter(shared, index.contents);
+    }
+    shared.loaded = true;
+    shared.generation = index.generation;
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::rebuildUsernameFilter(UsernameFilter& shared, std::string_view users) {
+    uint64_t count = 0;
+    forEachLine(users, [&count](std::string_view) { count++; });
+    
+    // Leave room to grow before the next rebuild
+    BloomFilter filter(std::max<uint64_t>(1024, count * 2));
+    forEachLine(users, [&filter](std::string_view line) {
+        nextField(line, ',');
+        filter.add(nextField(line, ','));
+    });
+    filter.copyStats(shared.filter);
+    shared.filter = std::move(filter);
+    shared.dirty = false;
+    writeContents(USERS_FILTER_FILE, shared.filter.serialize());
+}
+
+template <typename Backend>
+void BasicStorage<Backend>::saveUsernameFilter() {
+    UsernameFilter& shared = usernameFilter();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (shared.dirty && shared.generation == Backend::getGeneration()) {
+        shared.dirty = false;
+        writeContents(USERS_FILTER_FILE, shared.filter.serialize());
+    }
+}
+
+template <typename Backend>
+std::vector<Session> BasicStorage<Backend>::getAllSessions() {
+    std::vector<Session> sessions;
+    forEachSession([&sessions](Session&& session) { sessions.push_back(std::move(session)); });
+    return sessions;
+}
+
+template <typename Backend>
+Session BasicStorage<Backend>::getSessionByToken(std::string_view token) {
+    FileIndex& index = sessionsIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, SESSIONS_FILE);
+    auto it = index.byKey.find(token);
+    if (it == index.byKey.end()) {
+        return Session(); // Return empty session if not found
+    }
+    return Session::deserialize(index.lineAt(it->second));
+}
+
+template <typename Backend>
+bool BasicStorage<Backend>::saveSession(const Session& session) {
+    FileIndex& index = sessionsIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, SESSIONS_FILE);
+    
+    std::string updated;
+    updated.reserve(index.contents.size() + 64);
+    bool replaced = false;
+    time_t now = time(nullptr);
+    
+    // Replace or append the session, dropping expired ones on the way
+    forEachLine(index.contents, [&](std::string_view line) {
+        std::string_view fields[4];
+        if (!splitFields(line, fields)) {
+            return;
+        }
+        if (!replaced && fields[0] == session.getToken()) {
+            replaced = true;
+            if (session.getExpiryTime() > now) {
+                updated += session.serialize();
+                updated += '\n';
+            }
+        } else if (parseNumber<time_t>(fields[3]) > now) {
+            updated += line;
+            updated += '\n';
+        }
+    });
+    
+    if (!replaced && session.getExpiryTime() > now) {
+        updated += session.serialize();
+        updated += '\n';
+    }
+    
+    return replaceContents(index, SESSIONS_FILE, std::move(updated));
+}
+
+template <typename Backend>
+bool BasicStorage<Backend>::deleteSession(std::string_view token) {
+    FileIndex& index = sessionsIndex();
+    std::lock_guard<std::mutex> lock(index.mutex);
+    loadIndex(index, SESSIONS_FILE);
+    
+    auto it = index.byKey.find(token);
+    if (it == index.byKey.end()) {
+        return true;
+    }
+    size_t length = index.lineAt(it->second).size() + 1;
+    std::string updated = index.contents;
+    updated.erase(it->second, length);
+    return replaceContents(index, SESSIONS_FILE, std::move(updated));
+}
+
+// Backends available to BasicStorage
+template class BasicStorage<CsvBackend>;
+template class BasicStorage<MemoryBackend>;
+template class BasicStorage<LogBackend>;
\ No newline at end of file
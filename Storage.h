@@ -2,9 +2,19 @@
 #define STORAGE_H
 
 #include <string>
+#include <string_view>
+#include <charconv>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <condition_variable>
 #include <ctime>
+#include <cstdint>
+#include <mutex>
+#include "StorageBackend.h"
+#include "BloomFilter.h"
 
 // Forward declarations to avoid circular dependencies
 class User;
@@ -13,6 +23,35 @@ class Session;
 // Utility function to split strings
 std::vector<std::string> split(const std::string& s, char delimiter);
 
+// Return the next delimited field of rest and advance rest past it, without copying
+std::string_view nextField(std::string_view& rest, char delimiter);
+
+// Parse a numeric field, returning 0 when it is malformed
+template <typename T>
+T parseNumber(std::string_view field) {
+    T value = 0;
+    std::from_chars(field.data(), field.data() + field.size(), value);
+    return value;
+}
+
+// Parse a numeric field; false unless the whole field is a valid number
+template <typename T>
+bool parseNumber(std::string_view field, T& value) {
+    auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+    return !field.empty() && result.ec == std::errc() && result.ptr == field.data() + field.size();
+}
+
+// Call visit(line) for every non-empty line of contents
+template <typename Visitor>
+void forEachLine(std::string_view contents, Visitor&& visit) {
+    while (!contents.empty()) {
+        std::string_view line = nextField(contents, '\n');
+        if (!line.empty()) {
+            visit(line);
+        }
+    }
+}
+
 // User class to store authentication information
 class User {
 private:
@@ -25,12 +64,12 @@ private:
 
 public:
     User();
-    User(int userId, const std::string& user, const std::string& hash);
+    User(int userId, std::string user, std::string hash);
     
     // Getters
     int getId() const;
-    std::string getUsername() const;
-    std::string getPasswordHash() const;
+    const std::string& getUsername() const;
+    const std::string& getPasswordHash() const;
     bool isLocked() const;
     
     // Authentication methods
@@ -39,7 +78,7 @@ public:
     
     // Serialization
     std::string serialize() const;
-    static User deserialize(const std::string& data);
+    static User deserialize(std::string_view data);
 };
 
 // Session class to manage user sessions
@@ -52,10 +91,10 @@ private:
     
 public:
     Session();
-    Session(int id, const std::string& sessionToken, int durationSeconds = 3600);
+    Session(int id, std::string sessionToken, int durationSeconds = 3600);
     
     // Getters
-    std::string getToken() const;
+    const std::string& getToken() const;
     int getUserId() const;
     time_t getExpiryTime() const;
     
@@ -65,32 +104,148 @@ public:
     
     // Serialization
     std::string serialize() const;
-    static Session deserialize(const std::string& data);
+    static Session deserialize(std::string_view data);
 };
 
-// Storage class to handle file operations
-class Storage {
+// Storage class to handle user and session persistence, parameterized on a
+// backend policy from StorageBackend.h
+template <typename Backend>
+class BasicStorage {
 private:
     const std::string USERS_FILE = "users.csv";
     const std::string SESSIONS_FILE = "sessions.csv";
+    const std::string USERS_FILTER_FILE = "users.bloom";
+    static const int USER_ID_BLOCK = 64;
+    Durability durability = Durability::Async;
+    Backend backend;
+    
+    // Username filter, shared by every storage over the same backend just
+    // like the files themselves
+    struct UsernameFilter {
+        std::mutex mutex;
+        BloomFilter filter;
+        bool loaded = false;
+        bool dirty = false;         // Holds names users.bloom does not
+        uint64_t generation = 0;    // Backend generation it was loaded from
+    };
+    static UsernameFilter& usernameFilter();
     
-    // Helper methods
-    std::vector<std::string> readAllLines(const std::string& filename);
-    void writeAllLines(const std::string& filename, const std::vector<std::string>& lines);
+    // A storage file held in memory with an offset index by key (username
+    // or token), so lookups deserialize only the matching line. Shared by
+    // every storage over the same backend and loaded on first use.
+    struct FileIndex {
+        const size_t keyField;
+        const bool indexIds;
+        std::mutex mutex;
+        bool loaded = false;
+        uint64_t generation = 0;    // Backend generation it was loaded from
+        std::string contents;
+        std::unordered_map<std::string_view, size_t> byKey;    // Key -> line offset
+        std::unordered_map<int, size_t> byId;                  // User id -> line offset
+        int maxId = 0;
+        size_t lines = 0;
+        
+        FileIndex(size_t keyField, bool indexIds) : keyField(keyField), indexIds(indexIds) {}
+        void rebuild();
+        void indexFrom(size_t offset);
+        void append(std::string_view records);
+        std::string_view lineAt(size_t offset) const;
+    };
+    static FileIndex& usersIndex();
+    static FileIndex& sessionsIndex();
+    
+    // New users waiting to be written. Usernames are claimed here before
+    // the users file is checked, so two registrations of the same name
+    // cannot both succeed. One caller at a time commits everything queued.
+    struct RegistrationQueue {
+        std::mutex mutex;
+        std::condition_variable committed;
+        std::vector<User> pending;
+        std::unordered_set<std::string> claimed;   // Queued or being committed
+        bool committing = false;
+        uint64_t openBatch = 1;                     // Batch new users join
+        uint64_t committedBatch = 0;
+        std::unordered_set<uint64_t> failedBatches; // Committed but not persisted
+        Durability durability = Durability::Async;  // Strongest asked of the open batch
+        std::atomic<int> nextId{0};                 // 0 until read from the users file
+        std::atomic<uint64_t> idGeneration{0};      // Backend generation nextId was read from
+    };
+    static RegistrationQueue& registrationQueue();
+    
+    // A thread's block of user ids from the shared counter
+    struct IdBlock {
+        int next = 0;
+        int end = 0;
+        uint64_t generation = 0;    // Backend generation it was reserved in
+    };
+    
+    // Helper methods; the index methods expect the index mutex to be held
+    bool writeContents(const std::string& filename, std::string contents);
+    void loadIndex(FileIndex& index, const std::string& filename);
+    bool replaceContents(FileIndex& index, const std::string& filename, std::string contents);
+    std::string readContents(FileIndex& index, const std::string& filename);
+    void loadUsernameFilter(UsernameFilter& shared);
+    void rebuildUsernameFilter(UsernameFilter& shared, std::string_view users);
+    int reserveUserIds(int count);
+    int allocateUserId();
+    bool commitUsers(const std::vector<User>& users, Durability mode);
     
 public:
+    // Load users and sessions concurrently, building only their indexes
+    void preload();
+    
     // User storage methods
     std::vector<User> getAllUsers();
     User getUserById(int id);
-    User getUserByUsername(const std::string& username);
+    User getUserByUsername(std::string_view username);
     bool saveUser(const User& user);
+    
+    // Reserve an id no other caller will get, for a user passed to saveUser
     int getNextUserId();
     
+    // Register a new user under a fresh id; returns the id, or 0 if the
+    // username is taken. Concurrent registrations are written together.
+    int createUser(const std::string& username, std::string passwordHash);
+    
+    // Whether a username is taken. Names the filter has never seen are
+    // answered without reading the user file.
+    bool usernameExists(std::string_view username);
+    
+    // Recreate the persisted username filter from the user file
+    void rebuildUsernameFilter();
+    
+    // Persist names added since the filter was last written; call at
+    // shutdown so the next start need not rebuild it
+    void saveUsernameFilter();
+    static BloomFilterStats getUsernameFilterStats();
+    
     // Session storage methods
     std::vector<Session> getAllSessions();
-    Session getSessionByToken(const std::string& token);
+    Session getSessionByToken(std::string_view token);
     bool saveSession(const Session& session);
-    bool deleteSession(const std::string& token);
+    bool deleteSession(std::string_view token);
+    
+    // Visit every stored user or session without building a vector
+    template <typename Visitor>
+    void forEachUser(Visitor&& visit) {
+        std::string contents = readContents(usersIndex(), USERS_FILE);
+        forEachLine(contents, [&visit](std::string_view line) { visit(User::deserialize(line)); });
+    }
+    
+    template <typename Visitor>
+    void forEachSession(Visitor&& visit) {
+        std::string contents = readContents(sessionsIndex(), SESSIONS_FILE);
+        forEachLine(contents, [&visit](std::string_view line) { visit(Session::deserialize(line)); });
+    }
+    
+    // Whether persisting calls wait for their writes to be fsynced
+    void setDurability(Durability mode);
+    
+    // Persistence statistics (process-wide, all storage files)
+    static uint64_t getBytesWritten();
 };
 
+// Default storage: CSV files in the working directory
+using Storage = BasicStorage<CsvBackend>;
+
 #endif
\ No newline at end of file
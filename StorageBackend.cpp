@@ -0,0 +1,378 @@
+#include "StorageBackend.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// CsvBackend implementation
+std::string CsvBackend::read(const std::string& name) {
+    // Writes still queued in the flusher are newer than the file on disk
+    std::string contents;
+    if (PersistenceFlusher::instance().pendingContents(name, contents)) {
+        return contents;
+    }
+
+    // Only regular files are read; anything else reads as empty
+    int fd = open(name.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0) {
+        return contents;
+    }
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        contents.resize(static_cast<size_t>(info.st_size));
+        size_t offset = 0;
+        while (offset < contents.size()) {
+            ssize_t count = ::read(fd, &contents[offset], contents.size() - offset);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                break;
+            }
+            offset += static_cast<size_t>(count);
+        }
+        contents.resize(offset);
+    }
+    close(fd);
+    return contents;
+}
+
+bool CsvBackend::write(const std::string& name, std::string contents, Durability durability) {
+    return PersistenceFlusher::instance().submit(name, std::move(contents), durability);
+}
+
+bool CsvBackend::append(const std::string& name, std::string records, Durability durability) {
+    return PersistenceFlusher::instance().append(name, std::move(records), durability);
+}
+
+bool CsvBackend::flush() {
+    return PersistenceFlusher::instance().flush();
+}
+
+uint64_t CsvBackend::getBytesWritten() {
+    return PersistenceFlusher::instance().getBytesWritten();
+}
+
+uint64_t CsvBackend::getGeneration() {
+    return 0;
+}
+
+// MemoryBackend implementation
+namespace {
+
+std::mutex memoryMutex;
+std::map<std::string, std::string> memoryFiles;
+std::atomic<uint64_t> memoryBytes(0);
+std::atomic<uint64_t> memoryGeneration(0);
+
+} // namespace
+
+std::string MemoryBackend::read(const std::string& name) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    auto it = memoryFiles.find(name);
+    return it == memoryFiles.end() ? std::string() : it->second;
+}
+
+bool MemoryBackend::write(const std::string& name, std::string contents, Durability) {
+    memoryBytes.fetch_add(contents.size(), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    memoryFiles[name] = std::move(contents);
+    return true;
+}
+
+bool MemoryBackend::append(const std::string& name, std::string records, Durability) {
+    memoryBytes.fetch_add(records.size(), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    memoryFiles[name] += records;
+    return true;
+}
+
+bool MemoryBackend::flush() {
+    return true;
+}
+
+uint64_t MemoryBackend::getBytesWritten() {
+    return memoryBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryBackend::getGeneration() {
+    return memoryGeneration.load();
+}
+
+void MemoryBackend::clear() {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    memoryFiles.clear();
+    memoryGeneration.fetch_add(1);
+}
+
+// LogBackend implementation
+namespace {
+
+const uint32_t LOG_MAGIC = 0x474f4c42;   // "BLOG": whole contents
+const uint32_t DELTA_MAGIC = 0x444c4742; // "BGLD": one changed byte range
+const uint64_t COMPACT_SLACK = 1024 * 1024;
+
+struct LogFile {
+    int fd = -1;
+    bool loaded = false;
+    uint64_t logBytes = 0;
+    std::string live;
+
+    ~LogFile() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+std::mutex logMutex;
+std::map<std::string, LogFile> logFiles;
+std::atomic<uint64_t> logBytesWritten(0);
+
+uint32_t checksum(const char* data, size_t size, uint32_t hash = 2166136261u) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t checksum(const std::string& data) {
+    return checksum(data.data(), data.size());
+}
+
+std::string encodeRecord(const std::string& contents) {
+    uint32_t header[2] = {LOG_MAGIC, static_cast<uint32_t>(contents.size())};
+    uint32_t sum = checksum(contents);
+    std::string record(reinterpret_cast<const char*>(header), sizeof(header));
+    record += contents;
+    record.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    return record;
+}
+
+// Replace removed bytes at offset with the payload; the checksum covers the
+// header too, so a damaged offset is caught
+std::string encodeDelta(size_t offset, size_t removed, const char* payload, size_t size) {
+    uint32_t header[4] = {DELTA_MAGIC, static_cast<uint32_t>(offset), static_cast<uint32_t>(removed),
+                          static_cast<uint32_t>(size)};
+    uint32_t sum = checksum(payload, size, checksum(reinterpret_cast<const char*>(header), sizeof(header)));
+    std::string record(reinterpret_cast<const char*>(header), sizeof(header));
+    record.append(payload, size);
+    record.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    return record;
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t written = ::write(fd, data.data() + offset, data.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Apply one record at offset to log.live; returns the offset past it, or
+// offset itself if the record is torn or corrupt
+size_t replayRecord(const std::string& contents, size_t offset, LogFile& log) {
+    uint32_t magic;
+    if (offset + sizeof(magic) > contents.size()) {
+        return offset;
+    }
+    std::memcpy(&magic, contents.data() + offset, sizeof(magic));
+
+    if (magic == LOG_MAGIC) {
+        uint32_t header[2];
+        if (offset + sizeof(header) + sizeof(uint32_t) > contents.size()) {
+            return offset;
+        }
+        std::memcpy(header, contents.data() + offset, sizeof(header));
+        size_t end = offset + sizeof(header) + header[1] + sizeof(uint32_t);
+        if (end > contents.size()) {
+            return offset;
+        }
+        const char* payload = contents.data() + offset + sizeof(header);
+        uint32_t sum;
+        std::memcpy(&sum, contents.data() + end - sizeof(sum), sizeof(sum));
+        if (sum != checksum(payload, header[1])) {
+            return offset;
+        }
+        log.live.assign(payload, header[1]);
+        return end;
+    }
+
+    if (magic == DELTA_MAGIC) {
+        uint32_t header[4];
+        if (offset + sizeof(header) + sizeof(uint32_t) > contents.size()) {
+            return offset;
+        }
+        std::memcpy(header, contents.data() + offset, sizeof(header));
+        size_t end = offset + sizeof(header) + header[3] + sizeof(uint32_t);
+        if (end > contents.size() || static_cast<size_t>(header[1]) + header[2] > log.live.size()) {
+            return offset;
+        }
+        const char* payload = contents.data() + offset + sizeof(header);
+        uint32_t sum;
+        std::memcpy(&sum, contents.data() + end - sizeof(sum), sizeof(sum));
+        if (sum != checksum(payload, header[3], checksum(reinterpret_cast<const char*>(header), sizeof(header)))) {
+            return offset;
+        }
+        log.live.replace(header[1], header[2], payload, header[3]);
+        return end;
+    }
+    return offset;
+}
+
+// Rebuild the contents by replaying an existing log. A torn or corrupt
+// tail (from a crash mid-append) ends the replay.
+void loadLog(const std::string& path, LogFile& log) {
+    std::ifstream file(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t offset = 0;
+    while (offset < contents.size()) {
+        size_t next = replayRecord(contents, offset, log);
+        if (next == offset) {
+            break;
+        }
+        offset = next;
+    }
+    log.logBytes = offset;
+    if (offset < contents.size()) {
+        // Drop the damaged tail so later appends stay readable
+        if (truncate(path.c_str(), static_cast<off_t>(offset)) != 0) {
+            std::cerr << "Failed to truncate " << path << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+    log.fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    log.loaded = true;
+}
+
+LogFile& openLog(const std::string& name) {
+    LogFile& log = logFiles[name];
+    if (!log.loaded) {
+        loadLog(name + ".log", log);
+    }
+    return log;
+}
+
+// Rewrite the log as a single record holding the live contents, durably;
+// false if the old log is still in use or the rename may not survive
+bool compactLog(const std::string& name, LogFile& log) {
+    std::string path = name + ".log";
+    std::string temp = path + ".tmp";
+    std::string record = encodeRecord(log.live);
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = writeAll(fd, record) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    close(log.fd);
+    log.fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    log.logBytes = record.size();
+    logBytesWritten.fetch_add(record.size(), std::memory_order_relaxed);
+    return log.fd >= 0 && syncDirectory(directoryOf(path));
+}
+
+// Append one record to the log. A record that fails part way is cut off
+// again, or replay would stop there and lose every later append; failing
+// that, the log is rewritten without it.
+bool appendRecord(const std::string& name, LogFile& log, const std::string& record) {
+    if (log.fd < 0 || !writeAll(log.fd, record)) {
+        std::cerr << "Failed to append " << name << ".log: " << std::strerror(errno) << std::endl;
+        if (log.fd >= 0 && ftruncate(log.fd, static_cast<off_t>(log.logBytes)) != 0) {
+            compactLog(name, log);
+        }
+        return false;
+    }
+    log.logBytes += record.size();
+    logBytesWritten.fetch_add(record.size(), std::memory_order_relaxed);
+    return true;
+}
+
+// Compact or sync after an append to the live contents
+bool finishAppend(const std::string& name, LogFile& log, Durability durability) {
+    // A compacted log is already durable; otherwise sync the append
+    if (log.logBytes > 4 * log.live.size() + COMPACT_SLACK && compactLog(name, log)) {
+        return true;
+    }
+    return durability == Durability::Async || (log.fd >= 0 && fdatasync(log.fd) == 0);
+}
+
+} // namespace
+
+std::string LogBackend::read(const std::string& name) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    return openLog(name).live;
+}
+
+bool LogBackend::write(const std::string& name, std::string contents, Durability durability) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    LogFile& log = openLog(name);
+
+    // Log only the range between the unchanged prefix and suffix, so an
+    // appended or edited line costs a record of about its own size
+    const std::string& live = log.live;
+    size_t shorter = std::min(live.size(), contents.size());
+    size_t prefix = std::mismatch(live.begin(), live.begin() + shorter, contents.begin()).first - live.begin();
+    size_t suffix = std::mismatch(live.rbegin(), live.rbegin() + (shorter - prefix), contents.rbegin()).first -
+                    live.rbegin();
+    size_t removed = live.size() - prefix - suffix;
+    size_t inserted = contents.size() - prefix - suffix;
+    if (removed == 0 && inserted == 0) {
+        return durability == Durability::Async || (log.fd >= 0 && fdatasync(log.fd) == 0);
+    }
+
+    if (!appendRecord(name, log, encodeDelta(prefix, removed, contents.data() + prefix, inserted))) {
+        return false;
+    }
+    log.live = std::move(contents);
+    return finishAppend(name, log, durability);
+}
+
+bool LogBackend::append(const std::string& name, std::string records, Durability durability) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    LogFile& log = openLog(name);
+    if (!appendRecord(name, log, encodeDelta(log.live.size(), 0, records.data(), records.size()))) {
+        return false;
+    }
+    log.live += records;
+    return finishAppend(name, log, durability);
+}
+
+bool LogBackend::flush() {
+    std::lock_guard<std::mutex> lock(logMutex);
+    bool ok = true;
+    for (auto& entry : logFiles) {
+        if (entry.second.fd >= 0 && fdatasync(entry.second.fd) != 0) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+uint64_t LogBackend::getBytesWritten() {
+    return logBytesWritten.load(std::memory_order_relaxed);
+}
+
+uint64_t LogBackend::getGeneration() {
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <string>
+#include <cstdint>
+#include "PersistenceFlusher.h"
+
+// Storage backend policies. BasicStorage and BasicBank are templated on one of
+// these, so calls resolve at compile time. Every backend stores whole named
+// files and provides the following, where false reports a failed write:
+//
+//   std::string read(const std::string& name);
+//   bool write(const std::string& name, std::string contents, Durability durability);
+//   bool append(const std::string& name, std::string records, Durability durability);
+//   static bool flush();                  // Make every accepted write durable
+//   static uint64_t getBytesWritten();    // Process-wide bytes persisted
+//   static uint64_t getGeneration();      // Changes when every file is dropped at once
+//
+// Names are process-wide: two instances of the same backend see the same data.
+
+// CSV text files in the working directory, written by the background flusher
+class CsvBackend {
+public:
+    std::string read(const std::string& name);
+    bool write(const std::string& name, std::string contents, Durability durability);
+    bool append(const std::string& name, std::string records, Durability durability);
+    static bool flush();
+    static uint64_t getBytesWritten();
+    static uint64_t getGeneration();
+};
+
+// Process-local memory only; nothing touches the filesystem
+class MemoryBackend {
+public:
+    std::string read(const std::string& name);
+    bool write(const std::string& name, std::string contents, Durability durability);
+    bool append(const std::string& name, std::string records, Durability durability);
+    static bool flush();
+    static uint64_t getBytesWritten();
+    static uint64_t getGeneration();
+
+    // Drop every stored file; caches built over them reload on next use
+    static void clear();
+};
+
+// Append-only binary logs (<name>.log). Each write appends one checksummed
+// record holding only the byte range that changed; reads return the
+// contents rebuilt by replaying the log. The log is compacted to a single
+// whole-contents record once it grows well past the live data. Appends run
+// on the caller's thread.
+class LogBackend {
+public:
+    std::string read(const std::string& name);
+    bool write(const std::string& name, std::string contents, Durability durability);
+    bool append(const std::string& name, std::string records, Durability durability);
+    static bool flush();
+    static uint64_t getBytesWritten();
+    static uint64_t getGeneration();
+};
+
+#endif
@@ -0,0 +1,496 @@
+#include "Workload.h"
+#include "Authentication.h"
+#include "BankAccount.h"
+#include "Storage.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const OperationType allTypes[] = {
+    OperationType::Register,
+    OperationType::Login,
+    OperationType::ValidateSession,
+    OperationType::OpenAccount,
+    OperationType::Deposit,
+    OperationType::Withdraw,
+    OperationType::Balance
+};
+const size_t typeCount = sizeof(allTypes) / sizeof(allTypes[0]);
+
+// A trace may not ask for more threads than this; each gets a manager
+const int maxTraceThreads = 1024;
+
+// Uniform double in [0, 1) built from raw generator bits, so traces are
+// reproducible across standard library implementations
+double uniform(std::mt19937_64& rng) {
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Zipf sampler over ranks [0, n) using a precomputed CDF
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfSampler(int n, double skew) {
+        cdf.reserve(n);
+        double sum = 0;
+        for (int i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(i, skew);
+            cdf.push_back(sum);
+        }
+        for (auto& value : cdf) {
+            value /= sum;
+        }
+    }
+
+    int sample(std::mt19937_64& rng) const {
+        double u = uniform(rng);
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), u);
+        if (it == cdf.end()) {
+            return static_cast<int>(cdf.size()) - 1;
+        }
+        return static_cast<int>(it - cdf.begin());
+    }
+};
+
+std::string userName(int index) {
+    return "lg_user_" + std::to_string(index);
+}
+
+std::string userPassword(int index) {
+    return "lg_pass_" + std::to_string(index);
+}
+
+std::string accountName(int index) {
+    return "LG" + std::to_string(index);
+}
+
+// Amount between 1.00 and 100.00 in whole cents
+double randomAmount(std::mt19937_64& rng) {
+    return (100 + static_cast<int>(uniform(rng) * 9900)) / 100.0;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+OperationStats summarize(const std::string& name, std::vector<double>& samples, uint64_t errors) {
+    std::sort(samples.begin(), samples.end());
+    OperationStats stats;
+    stats.name = name;
+    stats.count = samples.size();
+    stats.errors = errors;
+    stats.p50Micros = percentile(samples, 0.50);
+    stats.p99Micros = percentile(samples, 0.99);
+    stats.p999Micros = percentile(samples, 0.999);
+    return stats;
+}
+
+// State shared by every worker while a workload runs
+template <typename Backend>
+struct Target {
+    std::vector<std::unique_ptr<BasicAuthenticationManager<Backend>>> managers;
+    BasicBank<Backend> bank;
+};
+
+template <typename Backend>
+bool execute(Target<Backend>& target, const Operation& op) {
+    BasicAuthenticationManager<Backend>& auth = *target.managers[op.thread];
+    switch (op.type) {
+        case OperationType::Register:
+            return auth.registerUser(op.subject, op.secret);
+        case OperationType::Login:
+            return auth.login(op.subject, op.secret);
+        case OperationType::ValidateSession:
+            return auth.validateSession(auth.getCurrentSessionToken());
+        case OperationType::OpenAccount:
+            // addAccount only refuses ids that already exist, which a replay
+            // against an existing directory expects
+            return target.bank.addAccount(BankAccount(static_cast<int>(op.amount), op.subject, op.subject, 1000.0)) ||
+                   target.bank.snapshot().find(op.subject) != nullptr;
+        case OperationType::Deposit:
+            return target.bank.deposit(op.subject, op.amount);
+        case OperationType::Withdraw:
+            return target.bank.withdraw(op.subject, op.amount);
+        case OperationType::Balance:
+            return target.bank.getBalance(op.subject) >= 0;
+    }
+    return false;
+}
+
+} // namespace
+
+const char* operationTypeName(OperationType type) {
+    switch (type) {
+        case OperationType::Register: return "register";
+        case OperationType::Login: return "login";
+        case OperationType::ValidateSession: return "validate";
+        case OperationType::OpenAccount: return "open";
+        case OperationType::Deposit: return "deposit";
+        case OperationType::Withdraw: return "withdraw";
+        case OperationType::Balance: return "balance";
+    }
+    return "unknown";
+}
+
+Priority operationPriority(OperationType type) {
+    switch (type) {
+        case OperationType::Register:
+        case OperationType::Login:
+            return Priority::Authentication;
+        case OperationType::OpenAccount:
+        case OperationType::Deposit:
+        case OperationType::Withdraw:
+            return Priority::Transaction;
+        case OperationType::ValidateSession:
+        case OperationType::Balance:
+            return Priority::Interactive;
+    }
+    return Priority::Batch;
+}
+
+bool parseOperationType(const std::string& name, OperationType& type) {
+    for (auto candidate : allTypes) {
+        if (name == operationTypeName(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Workload implementation
+Workload::Workload() : threadCount(1) {}
+
+Workload Workload::generate(const WorkloadConfig& config) {
+    Workload workload;
+    workload.threadCount = std::max(config.threads, 1);
+    const int threads = workload.threadCount;
+    const int users = std::max(config.users, 1);
+    const int hotAccounts = std::max(config.hotAccounts, 1);
+    auto& ops = workload.operations;
+
+    // Setup: users for every scenario except the registration wave, and the
+    // hot accounts for the transaction mix
+    if (config.scenario != "register") {
+        for (int i = 0; i < users; ++i) {
+            ops.push_back({Phase::Setup, i % threads, OperationType::Register, userName(i), userPassword(i), 0});
+        }
+    }
+    if (config.scenario == "validate") {
+        for (int t = 0; t < threads; ++t) {
+            int user = t % users;
+            ops.push_back({Phase::Setup, t, OperationType::Login, userName(user), userPassword(user), 0});
+        }
+    }
+    if (config.scenario == "mix" || config.scenario == "surge") {
+        for (int i = 0; i < hotAccounts; ++i) {
+            ops.push_back({Phase::Setup, i % threads, OperationType::OpenAccount, accountName(i), "",
+                           static_cast<double>(i % users + 1)});
+        }
+    }
+
+    ZipfSampler zipf(hotAccounts, config.zipfSkew);
+    for (int t = 0; t < threads; ++t) {
+        std::mt19937_64 rng(config.seed * 0x9E3779B97F4A7C15ULL + t);
+        for (int i = 0; i < config.operations; ++i) {
+            Operation op{Phase::Run, t, OperationType::Balance, "", "", 0};
+            if (config.scenario == "register") {
+                op.type = OperationType::Register;
+                op.subject = "lg_new_" + std::to_string(config.seed) + "_" + std::to_string(t) + "_" + std::to_string(i);
+                op.secret = "lg_pass_new";
+            } else if (config.scenario == "login") {
+                int user = static_cast<int>(uniform(rng) * users);
+                op.type = OperationType::Login;
+                op.subject = userName(user);
+                op.secret = uniform(rng) < config.loginFailureRate ? "wrong_password" : userPassword(user);
+            } else if (config.scenario == "validate") {
+                op.type = OperationType::ValidateSession;
+            } else if (config.scenario == "surge" && t % 2 == 0) {
+                // Half the threads register new users while the rest read balances
+                op.type = OperationType::Register;
+                op.subject = "lg_surge_" + std::to_string(config.seed) + "_" + std::to_string(t) + "_" + std::to_string(i);
+                op.secret = "lg_pass_new";
+            } else if (config.scenario == "surge") {
+                op.subject = accountName(zipf.sample(rng));
+            } else {
+                double pick = uniform(rng);
+                if (pick < config.depositRatio) {
+                    op.type = OperationType::Deposit;
+                } else if (pick < config.depositRatio + config.withdrawRatio) {
+                    op.type = OperationType::Withdraw;
+                }
+                op.subject = accountName(zipf.sample(rng));
+                if (op.type != OperationType::Balance) {
+                    op.amount = randomAmount(rng);
+                }
+            }
+            ops.push_back(op);
+        }
+    }
+    return workload;
+}
+
+bool Workload::save(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "# threads=" << threadCount << std::endl;
+    file << std::fixed << std::setprecision(2);
+    for (const auto& op : operations) {
+        file << (op.phase == Phase::Setup ? "setup" : "run") << "," << op.thread << ","
+             << operationTypeName(op.type) << "," << op.subject << "," << op.secret << ","
+             << op.amount << std::endl;
+    }
+    return true;
+}
+
+bool Workload::load(const std::string& filename, Workload& workload) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    workload.operations.clear();
+    workload.threadCount = 0;
+    const std::string threadsHeader = "# threads=";
+    std::string line;
+    while (std::getline(file, line)) {
+        // The thread count written by save() bounds every operation's thread
+        if (line.compare(0, threadsHeader.size(), threadsHeader) == 0) {
+            int threads = 0;
+            if (workload.threadCount != 0 || !parseNumber(std::string_view(line).substr(threadsHeader.size()), threads) ||
+                threads < 1 || threads > maxTraceThreads) {
+                std::cerr << "Malformed trace header: " << line << std::endl;
+                return false;
+            }
+            workload.threadCount = threads;
+            continue;
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (workload.threadCount == 0) {
+            std::cerr << "Trace has no threads header before: " << line << std::endl;
+            return false;
+        }
+        auto parts = split(line, ',');
+        Operation op;
+        if (parts.size() < 6 || !parseOperationType(parts[2], op.type) ||
+            !parseNumber(parts[1], op.thread) || op.thread < 0 || op.thread >= workload.threadCount ||
+            !parseNumber(parts[5], op.amount)) {
+            std::cerr << "Malformed trace line: " << line << std::endl;
+            return false;
+        }
+        op.phase = parts[0] == "setup" ? Phase::Setup : Phase::Run;
+        op.subject = parts[3];
+        op.secret = parts[4];
+        workload.operations.push_back(op);
+    }
+    if (workload.threadCount == 0) {
+        workload.threadCount = 1;
+    }
+    return true;
+}
+
+WorkloadReport Workload::run(Durability durability, const std::string& backend, size_t schedulerWorkers) const {
+    WorkloadReport report;
+    if (backend == "memory") {
+        report = runOn<MemoryBackend>(durability, schedulerWorkers);
+    } else if (backend == "log") {
+        report = runOn<LogBackend>(durability, schedulerWorkers);
+    } else {
+        report = runOn<CsvBackend>(durability, schedulerWorkers);
+    }
+    report.backend = backend;
+    return report;
+}
+
+template <typename Backend>
+WorkloadReport Workload::runOn(Durability durability, size_t schedulerWorkers) const {
+    Target<Backend> target;
+    for (int t = 0; t < threadCount; ++t) {
+        target.managers.emplace_back(new BasicAuthenticationManager<Backend>());
+        target.managers.back()->setDurability(durability);
+    }
+
+    // Lazy startup: index users and sessions while the accounts are opened
+    auto opening = std::chrono::steady_clock::now();
+    std::thread preload([&target]() { target.managers.front()->preload(); });
+    target.bank.openAccounts();
+    preload.join();
+    double startupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - opening).count();
+    target.bank.setDurability(durability);
+
+    // Setup runs sequentially and untimed
+    std::vector<std::vector<const Operation*>> perThread(threadCount);
+    for (const auto& op : operations) {
+        if (op.phase == Phase::Setup) {
+            execute(target, op);
+        } else {
+            perThread[op.thread].push_back(&op);
+        }
+    }
+
+    // latencies[thread][type] in microseconds
+    std::vector<std::vector<std::vector<double>>> latencies(threadCount, std::vector<std::vector<double>>(typeCount));
+    std::vector<std::vector<uint64_t>> errors(threadCount, std::vector<uint64_t>(typeCount, 0));
+
+    // Clients wait for each operation, so a manager never runs two at once
+    std::unique_ptr<OperationScheduler> scheduler;
+    if (schedulerWorkers > 0) {
+        scheduler.reset(new OperationScheduler(schedulerWorkers));
+    }
+
+    std::mutex startMutex;
+    std::condition_variable startSignal;
+    bool started = false;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&, t]() {
+            {
+                std::unique_lock<std::mutex> lock(startMutex);
+                startSignal.wait(lock, [&started]() { return started; });
+            }
+            for (const Operation* op : perThread[t]) {
+                auto begin = std::chrono::steady_clock::now();
+                bool ok = false;
+                if (scheduler) {
+                    scheduler->call(operationPriority(op->type), [&]() { ok = execute(target, *op); });
+                } else {
+                    ok = execute(target, *op);
+                }
+                auto end = std::chrono::steady_clock::now();
+                size_t type = static_cast<size_t>(op->type);
+                latencies[t][type].push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+                if (!ok) {
+                    errors[t][type]++;
+                }
+            }
+        });
+    }
+
+    Backend::flush();
+    uint64_t bytesBefore = Backend::getBytesWritten();
+    auto begin = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        started = true;
+    }
+    startSignal.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    target.managers.front()->shutdown();
+    Backend::flush();
+    auto flushed = std::chrono::steady_clock::now();
+
+    WorkloadReport report;
+    report.startupSeconds = startupSeconds;
+    report.wallSeconds = std::chrono::duration<double>(end - begin).count();
+    report.flushSeconds = std::chrono::duration<double>(flushed - end).count();
+    report.bytesWritten = Backend::getBytesWritten() - bytesBefore;
+    report.usernameFilter = BasicStorage<Backend>::getUsernameFilterStats();
+    report.accountFilter = target.bank.getAccountFilterStats();
+    report.portfolioDrift = target.bank.verifyPortfolios().size();
+    if (scheduler) {
+        scheduler->shutdown();
+        for (Priority priority : {Priority::Interactive, Priority::Transaction, Priority::Authentication, Priority::Batch}) {
+            report.scheduler.push_back(scheduler->getStats(priority));
+        }
+    }
+
+    std::vector<double> all;
+    uint64_t allErrors = 0;
+    for (size_t type = 0; type < typeCount; ++type) {
+        std::vector<double> samples;
+        uint64_t typeErrors = 0;
+        for (int t = 0; t < threadCount; ++t) {
+            samples.insert(samples.end(), latencies[t][type].begin(), latencies[t][type].end());
+            typeErrors += errors[t][type];
+        }
+        if (samples.empty()) {
+            continue;
+        }
+        all.insert(all.end(), samples.begin(), samples.end());
+        allErrors += typeErrors;
+        report.perType.push_back(summarize(operationTypeName(allTypes[type]), samples, typeErrors));
+    }
+    report.operations = all.size();
+    report.overall = summarize("total", all, allErrors);
+    return report;
+}
+
+const std::vector<Operation>& Workload::getOperations() const {
+    return operations;
+}
+
+int Workload::getThreadCount() const {
+    return threadCount;
+}
+
+static void printFilterStats(const char* name, const BloomFilterStats& stats) {
+    std::cout << name << ": " << stats.items << " keys, " << stats.checks << " checks, "
+              << stats.maybePresent << " maybe, " << stats.falsePositives << " false positives ("
+              << std::setprecision(3) << stats.observedFalsePositiveRate * 100 << "% observed, "
+              << stats.estimatedFalsePositiveRate * 100 << "% estimated)" << std::endl;
+}
+
+void printReport(const WorkloadReport& report) {
+    std::cout << std::left << std::setw(10) << "operation" << std::right
+              << std::setw(10) << "count" << std::setw(10) << "errors"
+              << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+              << std::setw(12) << "p999(us)" << std::endl;
+
+    std::vector<OperationStats> rows = report.perType;
+    rows.push_back(report.overall);
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& row : rows) {
+        std::cout << std::left << std::setw(10) << row.name << std::right
+                  << std::setw(10) << row.count << std::setw(10) << row.errors
+                  << std::setw(12) << row.p50Micros << std::setw(12) << row.p99Micros
+                  << std::setw(12) << row.p999Micros << std::endl;
+    }
+
+    double throughput = report.wallSeconds > 0 ? report.operations / report.wallSeconds : 0;
+    std::cout << "startup: " << std::setprecision(3) << report.startupSeconds * 1000 << " ms" << std::endl;
+    std::cout << "wall time: " << std::setprecision(3) << report.wallSeconds << " s" << std::endl;
+    std::cout << "throughput: " << std::setprecision(1) << throughput << " ops/s" << std::endl;
+    std::cout << "flush drain: " << std::setprecision(3) << report.flushSeconds << " s (" << report.backend;
+    if (report.backend == "csv") {
+        std::cout << ", " << (PersistenceFlusher::instance().usingIoUring() ? "io_uring" : "thread pool");
+    }
+    std::cout << ")" << std::endl;
+    std::cout << "storage bytes written: " << report.bytesWritten << std::endl;
+    printFilterStats("username filter", report.usernameFilter);
+    printFilterStats("account filter", report.accountFilter);
+    std::cout << "portfolio drift: " << report.portfolioDrift << " users" << std::endl;
+    for (size_t i = 0; i < report.scheduler.size(); ++i) {
+        const SchedulerStats& stats = report.scheduler[i];
+        if (stats.submitted == 0) {
+            continue;
+        }
+        std::cout << "scheduler " << priorityName(static_cast<Priority>(i)) << ": " << stats.completed << " run, "
+                  << stats.failed << " failed, " << stats.shed << " shed, " << stats.stolen << " stolen, wait avg " << std::setprecision(1)
+                  << stats.averageWaitMicros << " us, max " << stats.maxWaitMicros << " us" << std::endl;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "PersistenceFlusher.h"
+#include "BloomFilter.h"
+#include "OperationScheduler.h"
+
+// Kind of operation issued by the load generator
+enum class OperationType {
+    Register,
+    Login,
+    ValidateSession,
+    OpenAccount,
+    Deposit,
+    Withdraw,
+    Balance
+};
+
+// Phase an operation belongs to; only Run operations are timed
+enum class Phase {
+    Setup,
+    Run
+};
+
+// A single generated or replayed operation
+struct Operation {
+    Phase phase;
+    int thread;             // Worker that issues the operation
+    OperationType type;
+    std::string subject;    // Username or account id
+    std::string secret;     // Password, empty for account operations
+    double amount;          // Deposit/withdraw amount, or owner id for OpenAccount
+};
+
+// Parameters of a generated workload
+struct WorkloadConfig {
+    std::string scenario = "mix";   // register | login | validate | mix | surge
+    uint64_t seed = 42;
+    int threads = 4;
+    int operations = 1000;          // Timed operations per thread
+    int users = 64;
+    int hotAccounts = 16;
+    double loginFailureRate = 0.1;
+    double zipfSkew = 0.99;
+    double depositRatio = 0.25;     // Remainder of the mix after deposits and
+    double withdrawRatio = 0.25;    // withdrawals is balance checks
+};
+
+// Latency summary for one operation type
+struct OperationStats {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t errors = 0;
+    double p50Micros = 0;
+    double p99Micros = 0;
+    double p999Micros = 0;
+};
+
+// Result of driving a workload against the library
+struct WorkloadReport {
+    double startupSeconds = 0;      // Opening users, sessions and accounts
+    double wallSeconds = 0;
+    uint64_t operations = 0;
+    uint64_t bytesWritten = 0;
+    double flushSeconds = 0;        // Time to drain the flusher after the run
+    std::string backend;
+    BloomFilterStats usernameFilter;
+    BloomFilterStats accountFilter;
+    size_t portfolioDrift = 0;              // Users whose aggregates disagree with their accounts
+    std::vector<SchedulerStats> scheduler;  // Per priority class; empty when unscheduled
+    std::vector<OperationStats> perType;
+    OperationStats overall;
+};
+
+// Deterministic workload generation, trace capture and replay
+class Workload {
+private:
+    std::vector<Operation> operations;
+    int threadCount;
+
+    template <typename Backend>
+    WorkloadReport runOn(Durability durability, size_t schedulerWorkers) const;
+
+public:
+    Workload();
+
+    // Build a workload from a config; identical configs give identical operations
+    static Workload generate(const WorkloadConfig& config);
+
+    // Trace capture and replay
+    bool save(const std::string& filename) const;
+    static bool load(const std::string& filename, Workload& workload);
+
+    // Execute against AuthenticationManager and Bank from one thread per
+    // worker, using the csv, memory or log storage backend. With scheduler
+    // workers, each thread is a client whose operations run on an
+    // OperationScheduler; shed operations count as errors.
+    WorkloadReport run(Durability durability = Durability::Async, const std::string& backend = "csv",
+                       size_t schedulerWorkers = 0) const;
+
+    const std::vector<Operation>& getOperations() const;
+    int getThreadCount() const;
+};
+
+// Text helpers shared by the load tool
+const char* operationTypeName(OperationType type);
+Priority operationPriority(OperationType type);
+bool parseOperationType(const std::string& name, OperationType& type);
+void printReport(const WorkloadReport& report);
+
+#endif
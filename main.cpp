@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <thread>
 #include "Authentication.h"
 #include "BankAccount.h"
 
@@ -20,9 +21,12 @@ int main() {
     // Initialize authentication manager
     AuthenticationManager authManager;
     
-    // Initialize bank system
+    // Initialize bank system; users, sessions and accounts are indexed
+    // concurrently and records are loaded as they are first used
     Bank bank;
-    bank.loadAccounts();
+    std::thread preload([&authManager]() { authManager.preload(); });
+    bank.openAccounts();
+    preload.join();
     
     bool running = true;
     while (running) {
@@ -103,6 +107,7 @@ int main() {
         }
     }
     
+    authManager.shutdown();
     std::cout << "Thank you for using our Banking System. Goodbye!\n";
     return 0;
 }